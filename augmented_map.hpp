@@ -0,0 +1,157 @@
+/**
+ * implement a map maintaining user-defined aggregates of subtrees
+ */
+#ifndef SJTU_AUGMENTED_MAP_HPP
+#define SJTU_AUGMENTED_MAP_HPP
+
+#include <functional>
+#include <cstddef>
+#include <limits>
+#include "map.hpp"
+
+namespace sjtu {
+
+    /**
+     * monoid summing the values.
+     * a monoid used by augmented_map provides value_type, identity(), combine(a, b) (associative,
+     * with identity() as its unit) and lift(key, value), the aggregate of a single element.
+     */
+    template<class Key, class T>
+    struct sum_monoid {
+        typedef T value_type;
+
+        inline static T identity() { return T(); }
+
+        inline static T combine(const T &a, const T &b) { return a + b; }
+
+        inline static T lift(const Key &, const T &value) { return value; }
+    };
+
+    /**
+     * monoid taking the maximum of the values.
+     */
+    template<class Key, class T>
+    struct max_monoid {
+        typedef T value_type;
+
+        inline static T identity() { return std::numeric_limits<T>::lowest(); }
+
+        inline static T combine(const T &a, const T &b) { return a < b ? b : a; }
+
+        inline static T lift(const Key &, const T &value) { return value; }
+    };
+
+    /**
+     * augmentation of map storing, in every node, the combination of its whole subtree under Monoid.
+     */
+    template<class Monoid>
+    struct monoid_augment {
+        static const bool enabled = true;
+
+        struct storage {
+            typename Monoid::value_type aggregate;
+        };
+
+        template<class Node>
+        inline static void pull(Node *p) {
+            typename Monoid::value_type result = Monoid::lift(p->data.first, p->data.second);
+            if (p->left_son != nullptr) { result = Monoid::combine(p->left_son->aggregate, result); }
+            if (p->right_son != nullptr) { result = Monoid::combine(result, p->right_son->aggregate); }
+            p->aggregate = result;
+        }
+    };
+
+    /**
+     * a map whose nodes keep the aggregate of their subtrees under a user monoid.
+     * the aggregates are maintained by insert, erase, rotations and copies of the underlying map,
+     * so the combination of all elements whose keys lie in a range takes O(log n).
+     * values changed in place (through an iterator or operator[]) must be followed by refresh().
+     */
+    template<
+            class Key,
+            class T,
+            class Monoid,
+            class Compare = std::less<Key>
+    >
+    class augmented_map : public map<Key, T, Compare, monoid_augment<Monoid> > {
+        typedef map<Key, T, Compare, monoid_augment<Monoid> > base;
+        typedef typename base::node node;
+        typedef typename Monoid::value_type aggregate_type;
+
+        inline static aggregate_type lift(node *p) { return Monoid::lift(p->data.first, p->data.second); }
+
+        //以p为根的子树中，key不小于lo的元素的聚合值
+        aggregate_type suffix_of(node *p, const Key &lo) const {
+            aggregate_type result = Monoid::identity();
+            while (p != nullptr) {
+                if (this->cmp(p->data.first, lo)) { p = p->right_son; }
+                else {//p与其右子树均在范围内，且排在之后找到的元素后面
+                    aggregate_type right = lift(p);
+                    if (p->right_son != nullptr) { right = Monoid::combine(right, p->right_son->aggregate); }
+                    result = Monoid::combine(right, result);
+                    p = p->left_son;
+                }
+            }
+            return result;
+        }
+
+        //以p为根的子树中，key小于hi的元素的聚合值
+        aggregate_type prefix_of(node *p, const Key &hi) const {
+            aggregate_type result = Monoid::identity();
+            while (p != nullptr) {
+                if (!this->cmp(p->data.first, hi)) { p = p->left_son; }
+                else {//p与其左子树均在范围内，且排在之前找到的元素前面
+                    aggregate_type left = lift(p);
+                    if (p->left_son != nullptr) { left = Monoid::combine(p->left_son->aggregate, left); }
+                    result = Monoid::combine(result, left);
+                    p = p->right_son;
+                }
+            }
+            return result;
+        }
+
+    public:
+
+        typedef typename base::value_type value_type;
+        typedef typename base::iterator iterator;
+        typedef typename base::const_iterator const_iterator;
+
+        //所有元素的聚合值
+        aggregate_type aggregate() const {
+            return this->root == nullptr ? Monoid::identity() : this->root->aggregate;
+        }
+
+        //key在[lo, hi)中的元素按key顺序的聚合值，O(log n)
+        aggregate_type aggregate(const Key &lo, const Key &hi) const {
+            node *p = this->root;
+            while (p != nullptr) {//找到第一个落在范围内的节点，范围内的元素均在其子树中
+                if (this->cmp(p->data.first, lo)) { p = p->right_son; }
+                else if (!this->cmp(p->data.first, hi)) { p = p->left_son; }
+                else { break; }
+            }
+            if (p == nullptr) { return Monoid::identity(); }
+            return Monoid::combine(Monoid::combine(suffix_of(p->left_son, lo), lift(p)),
+                                   prefix_of(p->right_son, hi));
+        }
+
+        //原地修改pos所指元素的值后，更新其到根的路径上的聚合值
+        void refresh(iterator pos) {
+            if (pos.get_map_point() != this || pos.get_iter_point() == nullptr) {
+                throw invalid_iterator();
+            }
+            base::pull_path(pos.get_iter_point());
+        }
+
+        //key不存在时插入，存在时替换其值并更新聚合值
+        pair<iterator, bool> insert_or_assign(const Key &key, const T &value) {
+            pair<iterator, bool> res = this->insert(value_type(key, value));
+            if (!res.second) {
+                res.first->second = value;
+                base::pull_path(res.first.get_iter_point());
+            }
+            return res;
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,185 @@
+/**
+ * implement a priority queue keeping only its best K elements
+ */
+#ifndef SJTU_BOUNDED_PRIORITY_QUEUE_HPP
+#define SJTU_BOUNDED_PRIORITY_QUEUE_HPP
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <utility>
+#include "exceptions.hpp"
+#include "vector.hpp"
+
+namespace sjtu {
+
+    /**
+     * keeps the K best elements pushed so far, "best" meaning greatest under Compare as in
+     * priority_queue (the K largest for std::less).
+     * the elements live in a binary heap stored inside the object, with the worst kept element
+     * on top. once K elements are kept, a new element that is not better than that threshold is
+     * rejected after one comparison, without touching the heap or allocating; a better one
+     * replaces the threshold and sinks, O(log K). elements equal to the threshold are rejected,
+     * so among equal elements the earliest are kept.
+     * the storage takes K * sizeof(T) bytes of the object, so K should stay small.
+     */
+    template<class T, size_t K, class Compare = std::less<T> >
+    class bounded_priority_queue {
+        static_assert(K > 0, "a bounded_priority_queue keeps at least one element");
+
+    private:
+
+        alignas(T) unsigned char storage[K * sizeof(T)];//data()[0]为最差的元素，data()[i]的儿子为2i+1与2i+2
+        size_t siz;
+
+        T *data() { return reinterpret_cast<T *>(storage); }
+
+        const T *data() const { return reinterpret_cast<const T *>(storage); }
+
+        inline static bool worse(const T &a, const T &b) { return Compare()(a, b); }
+
+        //data()[i]向上调整：先只做比较确定其位置，再沿路径把祖先依次下移
+        void rise(size_t i) {
+            T *a = data();
+            size_t pos = i;
+            while (pos > 0 && worse(a[i], a[(pos - 1) / 2])) { pos = (pos - 1) / 2; }
+            if (pos == i) { return; }
+            T value(std::move(a[i]));
+            a[i].~T();
+            for (size_t j = i; j != pos; j = (j - 1) / 2) {
+                new(a + j) T(std::move(a[(j - 1) / 2]));
+                a[(j - 1) / 2].~T();
+            }
+            new(a + pos) T(std::move(value));
+        }
+
+        //丢弃堆顶，以value填入并下沉；先沿路径比较、记下各层较差的儿子，再统一移动
+        void replace_top(T &value, size_t n) {
+            T *a = data();
+            size_t path[64], depth = 0;
+            for (size_t i = 0; i * 2 + 1 < n;) {
+                size_t son = i * 2 + 1;
+                if (son + 1 < n && worse(a[son + 1], a[son])) { ++son; }
+                if (!worse(a[son], value)) { break; }
+                path[depth++] = i = son;
+            }
+            a[0].~T();
+            size_t hole = 0;
+            for (size_t k = 0; k < depth; ++k) {
+                new(a + hole) T(std::move(a[path[k]]));
+                a[path[k]].~T();
+                hole = path[k];
+            }
+            new(a + hole) T(std::move(value));
+        }
+
+        //value优于当前门槛时加入，堆满时替换最差的元素
+        bool offer(T &value) {
+            if (siz < K) {
+                new(data() + siz) T(std::move(value));
+                ++siz;
+                try {
+                    rise(siz - 1);
+                } catch (...) {
+                    data()[--siz].~T();
+                    return false;
+                }
+                return true;
+            }
+            try {
+                replace_top(value, siz);
+            } catch (...) {
+                return false;
+            }
+            return true;
+        }
+
+        void destroy() {
+            while (siz > 0) { data()[--siz].~T(); }
+        }
+
+    public:
+
+        bounded_priority_queue() : siz(0) {}
+
+        bounded_priority_queue(const bounded_priority_queue &other) : siz(0) {
+            try {
+                for (; siz < other.siz; ++siz) { new(data() + siz) T(other.data()[siz]); }
+            } catch (...) {
+                destroy();
+                throw;
+            }
+        }
+
+        ~bounded_priority_queue() { destroy(); }
+
+        bounded_priority_queue &operator=(const bounded_priority_queue &other) {
+            if (this == &other) { return *this; }
+            destroy();
+            for (; siz < other.siz; ++siz) { new(data() + siz) T(other.data()[siz]); }
+            return *this;
+        }
+
+        //保留的元素中最差的一个，堆满时新元素须优于它才会被保留
+        const T &threshold() const {
+            if (empty()) { throw container_is_empty(); }
+            return data()[0];
+        }
+
+        //返回e是否被保留；堆满且e不优于门槛时只比较一次。与priority_queue一致，比较抛出异常时不插入
+        bool push(const T &e) {
+            if (siz == K) {
+                try {
+                    if (!worse(data()[0], e)) { return false; }
+                } catch (...) { return false; }
+            }
+            T value(e);
+            return offer(value);
+        }
+
+        bool push(T &&e) {
+            if (siz == K) {
+                try {
+                    if (!worse(data()[0], e)) { return false; }
+                } catch (...) { return false; }
+            }
+            return offer(e);
+        }
+
+        size_t size() const { return siz; }
+
+        bool empty() const { return siz == 0; }
+
+        bool full() const { return siz == K; }
+
+        static size_t capacity() { return K; }
+
+        void clear() { destroy(); }
+
+        /**
+         * returns the kept elements from best to worst and leaves the queue empty.
+         * the heap is sorted in place (the worst element is moved to the back each round), then
+         * copied to the vector. if a comparison or a copy throws, the queue is cleared.
+         */
+        vector<T> sorted_drain() {
+            vector<T> result;
+            try {
+                for (size_t n = siz; n > 1; --n) {
+                    T worst(std::move(data()[0]));
+                    T last(std::move(data()[n - 1]));
+                    data()[n - 1].~T();
+                    new(data() + n - 1) T(std::move(worst));
+                    replace_top(last, n - 1);
+                }
+                for (size_t i = 0; i < siz; ++i) { result.push_back(data()[i]); }
+            } catch (...) {
+                destroy();
+                throw;
+            }
+            destroy();
+            return result;
+        }
+    };
+}
+
+#endif
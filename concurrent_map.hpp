@@ -0,0 +1,152 @@
+/**
+ * implement a thread-safe map by sharding
+ */
+#ifndef SJTU_CONCURRENT_MAP_HPP
+#define SJTU_CONCURRENT_MAP_HPP
+
+#include <functional>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include "map.hpp"
+
+namespace sjtu {
+
+    /**
+     * a thread-safe map.
+     * keys are partitioned by Hash into several shards, each shard is a sjtu::map guarded by its own
+     * reader-writer lock, so operations on different shards never contend.
+     * keys are ordered inside a shard but not across shards.
+     */
+    template<
+            class Key,
+            class T,
+            class Compare = std::less<Key>,
+            class Hash = std::hash<Key>
+    >
+    class concurrent_map {
+    public:
+
+        typedef pair<const Key, T> value_type;
+
+    private:
+
+        struct alignas(64) shard {//按缓存行对齐，避免相邻分片的锁伪共享
+            mutable std::shared_mutex lock;
+            map<Key, T, Compare> data;
+        };
+
+        shard *shards;
+        size_t shard_count;
+
+        shard &shard_of(const Key &key) const {
+            uint64_t h = Hash()(key);//在64位上打散，size_t只有32位时移位与乘法同样有效
+            h ^= h >> 33;
+            h *= 0xff51afd7ed558ccdULL;//打散哈希值，避免整数key的恒等哈希集中在少数分片
+            h ^= h >> 33;
+            return shards[size_t(h % shard_count)];
+        }
+
+    public:
+
+        explicit concurrent_map(size_t shard_count_ = 64) {
+            if (shard_count_ == 0) { throw runtime_error(); }
+            shard_count = shard_count_;
+            shards = new shard[shard_count];
+        }
+
+        concurrent_map(const concurrent_map &other) = delete;
+
+        concurrent_map &operator=(const concurrent_map &other) = delete;
+
+        ~concurrent_map() { delete[] shards; }
+
+        //key不存在时插入，返回是否插入成功
+        bool insert(const value_type &value) {
+            shard &s = shard_of(value.first);
+            std::unique_lock<std::shared_mutex> guard(s.lock);
+            return s.data.insert(value).second;
+        }
+
+        //key不存在时插入，存在时替换其值，返回是否为新插入
+        bool insert_or_assign(const Key &key, const T &value) {
+            shard &s = shard_of(key);
+            std::unique_lock<std::shared_mutex> guard(s.lock);
+            pair<typename map<Key, T, Compare>::iterator, bool> res = s.data.insert(value_type(key, value));
+            if (!res.second) { res.first->second = value; }
+            return res.second;
+        }
+
+        //删除key对应的元素，返回删除的个数（0或1）
+        size_t erase(const Key &key) {
+            shard &s = shard_of(key);
+            std::unique_lock<std::shared_mutex> guard(s.lock);
+            typename map<Key, T, Compare>::iterator it = s.data.find(key);
+            if (it == s.data.end()) { return 0; }
+            s.data.erase(it);
+            return 1;
+        }
+
+        //查找key，存在时将其值复制到result并返回true
+        bool find(const Key &key, T &result) const {
+            const shard &s = shard_of(key);
+            std::shared_lock<std::shared_mutex> guard(s.lock);
+            typename map<Key, T, Compare>::const_iterator it = s.data.find(key);
+            if (it == s.data.cend()) { return false; }
+            result = it->second;
+            return true;
+        }
+
+        size_t count(const Key &key) const {
+            const shard &s = shard_of(key);
+            std::shared_lock<std::shared_mutex> guard(s.lock);
+            return s.data.count(key);
+        }
+
+        //key存在时，在持有该分片写锁的情况下调用func(T &)原地修改其值，返回key是否存在
+        template<class Func>
+        bool update(const Key &key, Func func) {
+            shard &s = shard_of(key);
+            std::unique_lock<std::shared_mutex> guard(s.lock);
+            typename map<Key, T, Compare>::iterator it = s.data.find(key);
+            if (it == s.data.end()) { return false; }
+            func(it->second);
+            return true;
+        }
+
+        //逐个分片遍历，对每个元素调用func(const value_type &)
+        //遍历某一分片时持有其读锁，因此每个分片内看到的是一致的状态，但不同分片可能处于不同时刻
+        template<class Func>
+        void for_each(Func func) const {
+            for (size_t i = 0; i < shard_count; ++i) {
+                std::shared_lock<std::shared_mutex> guard(shards[i].lock);
+                for (typename map<Key, T, Compare>::const_iterator it = shards[i].data.cbegin();
+                     it != shards[i].data.cend(); ++it) {
+                    func(*it);
+                }
+            }
+        }
+
+        //逐个分片加读锁求和，并发修改时结果只是近似值
+        size_t size() const {
+            size_t siz = 0;
+            for (size_t i = 0; i < shard_count; ++i) {
+                std::shared_lock<std::shared_mutex> guard(shards[i].lock);
+                siz += shards[i].data.size();
+            }
+            return siz;
+        }
+
+        bool empty() const { return size() == 0; }
+
+        void clear() {
+            for (size_t i = 0; i < shard_count; ++i) {
+                std::unique_lock<std::shared_mutex> guard(shards[i].lock);
+                shards[i].data.clear();
+            }
+        }
+    };
+}
+
+#endif
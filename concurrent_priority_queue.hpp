@@ -0,0 +1,145 @@
+/**
+ * implement a relaxed thread-safe priority queue (MultiQueue)
+ */
+#ifndef SJTU_CONCURRENT_PRIORITY_QUEUE_HPP
+#define SJTU_CONCURRENT_PRIORITY_QUEUE_HPP
+
+#include <functional>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include "priority_queue.hpp"
+
+namespace sjtu {
+
+    /**
+     * a thread-safe priority queue with relaxed ordering.
+     * elements are spread over several heaps (by default twice the number of hardware threads),
+     * each guarded by its own lock. push goes to a random heap; try_pop locks two random heaps and
+     * pops the better of their tops. a popped element is therefore not always the best one, but
+     * its expected rank is O(number of heaps), and threads almost never wait for each other.
+     * locks are only taken with try_lock on the fast path: a busy heap is skipped for another one.
+     * try_pop move-assigns the popped element into its argument, so T must be move-assignable;
+     * a type with a const member such as pair<const Key, T> cannot be used.
+     */
+    template<
+            class T,
+            class Compare = std::less<T>,
+            class Storage = dary_storage<>
+    >
+    class concurrent_priority_queue {
+    private:
+
+        struct alignas(64) shard {//按缓存行对齐，避免相邻堆的锁伪共享
+            mutable std::mutex lock;
+            priority_queue<T, Compare, Storage> heap;
+        };
+
+        shard *shards;
+        size_t shard_count;
+
+        static const int max_attempts = 16;//try_lock连续失败这么多次后改为阻塞加锁
+
+        //每个线程独立的xorshift随机数，不共享状态
+        static uint64_t random() {
+            thread_local uint64_t state = std::hash<std::thread::id>()(std::this_thread::get_id()) |
+                                          1;//状态不能为0
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            return state;
+        }
+
+        //以乘法代替取模，将随机数的高32位映射到[0, shard_count)
+        size_t random_shard() const { return size_t((random() >> 32) * shard_count >> 32); }
+
+        //在随机的一个堆上加锁并返回它，调用者负责解锁
+        shard &lock_random() {
+            for (int i = 0; i < max_attempts; ++i) {
+                shard &s = shards[random_shard()];
+                if (s.lock.try_lock()) { return s; }
+            }
+            shard &s = shards[random_shard()];
+            s.lock.lock();
+            return s;
+        }
+
+    public:
+
+        //heap_count_为内部堆的个数，为0时取硬件线程数的两倍
+        explicit concurrent_priority_queue(size_t heap_count_ = 0) {
+            if (heap_count_ == 0) { heap_count_ = 2 * size_t(std::thread::hardware_concurrency()); }
+            shard_count = (heap_count_ < 2 ? 2 : heap_count_);
+            shards = new shard[shard_count];
+        }
+
+        concurrent_priority_queue(const concurrent_priority_queue &other) = delete;
+
+        concurrent_priority_queue &operator=(const concurrent_priority_queue &other) = delete;
+
+        ~concurrent_priority_queue() { delete[] shards; }
+
+        void push(const T &e) {
+            shard &s = lock_random();
+            std::lock_guard<std::mutex> guard(s.lock, std::adopt_lock);
+            s.heap.push(e);
+        }
+
+        void push(T &&e) {
+            shard &s = lock_random();
+            std::lock_guard<std::mutex> guard(s.lock, std::adopt_lock);
+            s.heap.push(std::move(e));
+        }
+
+        //弹出一个接近最大的元素到result，返回是否成功
+        //随机取两个堆比较堆顶，弹出较大的一个；第二个堆正忙时只用第一个。多次只遇到空堆时，
+        //逐个检查所有的堆，都为空时返回false
+        bool try_pop(T &result) {
+            for (int i = 0; i < max_attempts; ++i) {
+                shard &a = shards[random_shard()];
+                std::unique_lock<std::mutex> guard_a(a.lock, std::try_to_lock);
+                if (!guard_a.owns_lock()) { continue; }
+                shard &b = shards[random_shard()];
+                std::unique_lock<std::mutex> guard_b;
+                if (&b != &a) { guard_b = std::unique_lock<std::mutex>(b.lock, std::try_to_lock); }
+                if (guard_b.owns_lock() && !b.heap.empty() &&
+                    (a.heap.empty() || Compare()(a.heap.top(), b.heap.top()))) {
+                    guard_a.unlock();
+                    b.heap.pop(result);
+                    return true;
+                }
+                if (guard_b.owns_lock()) { guard_b.unlock(); }
+                if (!a.heap.empty()) {
+                    a.heap.pop(result);
+                    return true;
+                }
+            }
+            for (size_t i = 0; i < shard_count; ++i) {
+                std::lock_guard<std::mutex> guard(shards[i].lock);
+                if (!shards[i].heap.empty()) {
+                    shards[i].heap.pop(result);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        //逐个堆加锁求和，并发修改时结果只是近似值
+        size_t size() const {
+            size_t siz = 0;
+            for (size_t i = 0; i < shard_count; ++i) {
+                std::lock_guard<std::mutex> guard(shards[i].lock);
+                siz += shards[i].heap.size();
+            }
+            return siz;
+        }
+
+        bool empty() const { return size() == 0; }
+
+        size_t heap_count() const { return shard_count; }
+    };
+}
+
+#endif
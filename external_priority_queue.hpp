@@ -0,0 +1,317 @@
+/**
+ * implement a priority queue spilling sorted runs to temporary files
+ */
+#ifndef SJTU_EXTERNAL_PRIORITY_QUEUE_HPP
+#define SJTU_EXTERNAL_PRIORITY_QUEUE_HPP
+
+#include <functional>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <new>
+#include <type_traits>
+#include "exceptions.hpp"
+#include "priority_queue.hpp"
+#include "vector.hpp"
+
+namespace sjtu {
+
+    /**
+     * a priority queue whose elements need not fit in memory.
+     * push goes to an in-memory priority_queue holding at most buffer_limit elements; when it is
+     * full, all its elements are popped in order and written with large sequential writes to a
+     * temporary file (std::tmpfile, removed when closed), forming a sorted run.
+     * top and pop compare the top of the buffer with the best head among the runs, which are
+     * merged lazily: a second heap holds one element per run, and each run is read back one
+     * block at a time only when its head is popped.
+     * every open run holds a file and, once read, a block of memory. when a spill leaves more
+     * than max_runs of them, some of the smallest are merged into a single run, so the files
+     * and read blocks stay bounded.
+     * T must be trivially copyable, since the runs store its bytes. I/O errors throw
+     * runtime_error; the elements of a run being written when the error occurs are lost.
+     */
+    template<class T, class Compare = std::less<T> >
+    class external_priority_queue {
+        static_assert(std::is_trivially_copyable<T>::value,
+                      "external_priority_queue requires a trivially copyable T");
+
+    private:
+
+        struct run {
+            std::FILE *file;
+            uint64_t remaining;//文件中尚未读入的元素个数
+            T *block;//读缓冲，第一次读时才分配
+            size_t pos, len;
+
+            run() : file(nullptr), remaining(0), block(nullptr), pos(0), len(0) {}
+
+            ~run() {
+                if (file != nullptr) { std::fclose(file); }
+                ::operator delete(block);
+            }
+        };
+
+        struct head {//一个段当前的首元素及段的编号
+            T value;
+            size_t index;
+
+            head(const T &value_, size_t index_) : value(value_), index(index_) {}
+        };
+
+        struct head_less {
+            bool operator()(const head &a, const head &b) const { return Compare()(a.value, b.value); }
+        };
+
+        priority_queue<T, Compare, dary_storage<> > buffer;//插入缓冲
+        priority_queue<head, head_less, dary_storage<> > heads;//各段的首元素，多路归并用
+        vector<run *> runs;//已写出的段，读完的段关闭后置为nullptr
+        size_t buffer_limit;
+        size_t block_count;//每次读写的元素个数
+        size_t max_runs;//写出段后仍打开的段的上限
+        size_t live_runs;
+        size_t open_runs;//文件未关闭的段的个数；被归并掉的段只剩heads中的首元素，不占文件
+        uint64_t spilled;//段中（含heads中）的元素个数
+        uint64_t write_bytes, read_bytes;//读写的字节数
+
+        //创建一个空的段
+        static run *new_run() {
+            run *r = new run;
+            r->file = std::tmpfile();
+            if (r->file == nullptr) {
+                delete r;
+                throw runtime_error();
+            }
+            std::setvbuf(r->file, nullptr, _IONBF, 0);//每次读写已是整块，不需要stdio的缓冲
+            return r;
+        }
+
+        //将缓冲中的元素按顺序写成一个新的段，其首元素放入heads；打开的段过多时归并其中较小的几个
+        void spill() {
+            run *r = new_run();
+            T *out = nullptr;
+            try {
+                out = static_cast<T *>(::operator new(block_count * sizeof(T)));
+                if (live_runs == 0) { runs.clear(); }
+                runs.push_back(r);
+            } catch (...) {
+                ::operator delete(out);
+                delete r;
+                throw;
+            }
+            size_t count = buffer.size();
+            T first = buffer.top();
+            bool ok = true;
+            for (size_t n = 0; ok && !buffer.empty(); n = 0) {
+                for (; n < block_count && !buffer.empty(); ++n) {
+                    new(out + n) T(buffer.top());
+                    buffer.pop();
+                }
+                ok = std::fwrite(out, sizeof(T), n, r->file) == n;
+            }
+            ::operator delete(out);
+            //首元素已在heads中，读回时跳过
+            ok = ok && std::fseek(r->file, long(sizeof(T)), SEEK_SET) == 0;
+            if (!ok) {
+                runs[runs.size() - 1] = nullptr;
+                delete r;
+                throw runtime_error();
+            }
+            r->remaining = count - 1;
+            heads.push(head(first, runs.size() - 1));
+            ++live_runs;
+            ++open_runs;
+            spilled += count;
+            write_bytes += uint64_t(count) * sizeof(T);
+            if (open_runs > max_runs) { merge_runs(); }
+        }
+
+        //段r中除heads中的首元素外尚未弹出的元素个数
+        static uint64_t rest_of(const run *r) { return r->remaining + (r->len - r->pos); }
+
+        /**
+         * merges the rest of some of the open runs into a new run, then closes them and frees
+         * their read blocks.
+         * the open runs are taken from the smallest: the two smallest, then each next one while
+         * it holds no more elements than those taken so far together. a run is thus rewritten
+         * along with at least as much other data, and an element is rewritten O(log(spills))
+         * times.
+         * the heads of the merged runs stay in heads: each is no greater than the rest of its
+         * run, so it still comes out first, and the run is deleted when it is popped.
+         * if an I/O error occurs, the elements taken from the merged runs so far are lost.
+         */
+        void merge_runs() {
+            vector<size_t> chosen;//打开的段的编号，按剩余元素个数从小到大插入排序
+            for (size_t i = 0; i < runs.size(); ++i) {
+                if (runs[i] == nullptr || runs[i]->file == nullptr) { continue; }
+                chosen.push_back(i);
+                for (size_t j = chosen.size() - 1;
+                     j > 0 && rest_of(runs[chosen[j]]) < rest_of(runs[chosen[j - 1]]); --j) {
+                    size_t t = chosen[j];
+                    chosen[j] = chosen[j - 1];
+                    chosen[j - 1] = t;
+                }
+            }
+            uint64_t total = rest_of(runs[chosen[0]]) + rest_of(runs[chosen[1]]);
+            size_t merge_count = 2;
+            for (; merge_count < chosen.size() && rest_of(runs[chosen[merge_count]]) <= total; ++merge_count) {
+                total += rest_of(runs[chosen[merge_count]]);
+            }
+            while (chosen.size() > merge_count) { chosen.pop_back(); }
+            priority_queue<head, head_less, dary_storage<> > merging;
+            run *r = nullptr;
+            T *out = nullptr;
+            uint64_t taken = 0, count = 0;//从各段取出的、写入新段的元素个数
+            try {
+                for (size_t k = 0; k < chosen.size(); ++k) {
+                    const T *next = next_of(runs[chosen[k]]);
+                    if (next == nullptr) { continue; }
+                    ++taken;
+                    merging.push(head(*next, chosen[k]));
+                }
+                if (!merging.empty()) {//各段都只剩首元素时不需要新段
+                    r = new_run();
+                    runs.push_back(r);
+                    out = static_cast<T *>(::operator new(block_count * sizeof(T)));
+                    T first = merging.top().value;//成为新段的首元素，不写入文件
+                    size_t n = 0;
+                    while (!merging.empty()) {
+                        size_t index = merging.top().index;
+                        if (count > 0) { new(out + n++) T(merging.top().value); }
+                        ++count;
+                        const T *next = next_of(runs[index]);
+                        merging.pop();
+                        if (next != nullptr) {
+                            ++taken;
+                            merging.push(head(*next, index));
+                        }
+                        if (n == block_count || (n > 0 && merging.empty())) {
+                            if (std::fwrite(out, sizeof(T), n, r->file) != n) { throw runtime_error(); }
+                            write_bytes += uint64_t(n) * sizeof(T);
+                            n = 0;
+                        }
+                    }
+                    if (std::fseek(r->file, 0, SEEK_SET) != 0) { throw runtime_error(); }
+                    r->remaining = count - 1;
+                    heads.push(head(first, runs.size() - 1));
+                }
+            } catch (...) {
+                ::operator delete(out);
+                if (r != nullptr) {
+                    if (runs.size() > 0 && runs[runs.size() - 1] == r) { runs[runs.size() - 1] = nullptr; }
+                    delete r;
+                }
+                spilled -= taken;
+                throw;
+            }
+            ::operator delete(out);
+            for (size_t k = 0; k < merge_count; ++k) {
+                run *old = runs[chosen[k]];
+                std::fclose(old->file);
+                old->file = nullptr;
+                ::operator delete(old->block);
+                old->block = nullptr;
+                old->remaining = 0;
+                old->pos = old->len = 0;
+                --open_runs;
+            }
+            if (r != nullptr) {
+                ++live_runs;
+                ++open_runs;
+            }
+        }
+
+        //段r中的下一个元素，在下次读该段前有效；段已读完时返回nullptr
+        const T *next_of(run *r) {
+            if (r->pos == r->len) {
+                if (r->remaining == 0) { return nullptr; }
+                if (r->block == nullptr) { r->block = static_cast<T *>(::operator new(block_count * sizeof(T))); }
+                size_t n = r->remaining < block_count ? size_t(r->remaining) : block_count;
+                if (std::fread(r->block, sizeof(T), n, r->file) != n) { throw runtime_error(); }
+                r->remaining -= n;
+                r->pos = 0;
+                r->len = n;
+                read_bytes += uint64_t(n) * sizeof(T);
+            }
+            return r->block + r->pos++;
+        }
+
+        //堆顶是否在段中
+        bool top_in_runs() const {
+            if (heads.empty()) { return false; }
+            return buffer.empty() || Compare()(buffer.top(), heads.top().value);
+        }
+
+    public:
+
+        /**
+         * buffer_limit_: the largest number of elements kept in memory before a spill.
+         * block_size: the size in bytes of each read and write; every open run keeps one such
+         * block in memory once it is read.
+         * max_runs_: the largest number of runs left open after a spill, at least 2, which
+         * bounds the temporary files and the read blocks.
+         */
+        explicit external_priority_queue(size_t buffer_limit_ = size_t(1) << 22,
+                                         size_t block_size = size_t(1) << 20,
+                                         size_t max_runs_ = 64)
+                : buffer_limit(buffer_limit_ == 0 ? 1 : buffer_limit_),
+                  block_count(block_size < sizeof(T) ? 1 : block_size / sizeof(T)),
+                  max_runs(max_runs_ < 2 ? 2 : max_runs_),
+                  live_runs(0), open_runs(0), spilled(0), write_bytes(0), read_bytes(0) {}
+
+        external_priority_queue(const external_priority_queue &other) = delete;
+
+        external_priority_queue &operator=(const external_priority_queue &other) = delete;
+
+        ~external_priority_queue() {
+            for (size_t i = 0; i < runs.size(); ++i) { delete runs[i]; }
+        }
+
+        const T &top() const {
+            if (empty()) { throw container_is_empty(); }
+            return top_in_runs() ? heads.top().value : buffer.top();
+        }
+
+        //缓冲已满时先写出一个段
+        void push(const T &e) {
+            if (buffer.size() >= buffer_limit) { spill(); }
+            buffer.push(e);
+        }
+
+        void pop() {
+            if (empty()) { throw container_is_empty(); }
+            if (!top_in_runs()) {
+                buffer.pop();
+                return;
+            }
+            size_t index = heads.top().index;
+            run *r = runs[index];
+            const T *next = next_of(r);//先读入下一个元素，读失败时不弹出
+            heads.pop();
+            --spilled;
+            if (next != nullptr) { heads.push(head(*next, index)); }
+            else {
+                if (r->file != nullptr) { --open_runs; }
+                delete r;
+                runs[index] = nullptr;
+                --live_runs;
+            }
+        }
+
+        size_t size() const { return buffer.size() + size_t(spilled); }
+
+        bool empty() const { return buffer.empty() && spilled == 0; }
+
+        //尚未读完的段的个数，含已被归并、只剩首元素的段
+        size_t run_count() const { return live_runs; }
+
+        //打开着临时文件的段的个数，写出段后不超过max_runs
+        size_t open_run_count() const { return open_runs; }
+
+        //写入与读出临时文件的字节数
+        uint64_t bytes_written() const { return write_bytes; }
+
+        uint64_t bytes_read() const { return read_bytes; }
+    };
+}
+
+#endif
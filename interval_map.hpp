@@ -0,0 +1,281 @@
+/**
+ * implement an interval tree on top of sjtu::map
+ */
+#ifndef SJTU_INTERVAL_MAP_HPP
+#define SJTU_INTERVAL_MAP_HPP
+
+#include <functional>
+#include <cstddef>
+#include <utility>
+#include "map.hpp"
+
+namespace sjtu {
+
+    /**
+     * orders closed intervals [lo, hi], stored as pair(lo, hi), by lo and then by hi.
+     */
+    template<class Point, class Compare = std::less<Point> >
+    struct interval_less {
+        Compare cmp;
+
+        bool operator()(const pair<Point, Point> &a, const pair<Point, Point> &b) const {
+            if (cmp(a.first, b.first)) { return true; }
+            if (cmp(b.first, a.first)) { return false; }
+            return cmp(a.second, b.second);
+        }
+    };
+
+    /**
+     * augmentation of map storing, in every node, the largest right endpoint in its subtree.
+     */
+    template<class Point, class Compare = std::less<Point> >
+    struct max_end_augment {
+        static const bool enabled = true;
+
+        struct storage {
+            Point max_end;
+        };
+
+        template<class Node>
+        inline static void pull(Node *p) {
+            Compare cmp;
+            const Point *result = &p->data.first.second;
+            if (p->left_son != nullptr && cmp(*result, p->left_son->max_end)) { result = &p->left_son->max_end; }
+            if (p->right_son != nullptr && cmp(*result, p->right_son->max_end)) { result = &p->right_son->max_end; }
+            p->max_end = *result;
+        }
+    };
+
+    /**
+     * a map from closed intervals [lo, hi] to values, ordered by (lo, hi).
+     * every node keeps the largest right endpoint of its subtree, so the intervals overlapping a
+     * query can be enumerated lazily in key order; finding each next result takes O(log n) and
+     * uses no memory besides the iterator itself.
+     * the map operations are those of sjtu::map, with keys of type pair<Point, Point>; every way of
+     * inserting except assign_sorted throws runtime_error for an interval whose lo is greater than hi.
+     */
+    template<
+            class Point,
+            class T,
+            class Compare = std::less<Point>
+    >
+    class interval_map : public map<pair<Point, Point>, T, interval_less<Point, Compare>,
+            max_end_augment<Point, Compare> > {
+        typedef map<pair<Point, Point>, T, interval_less<Point, Compare>, max_end_augment<Point, Compare> > base;
+        typedef typename base::node node;
+
+    public:
+
+        typedef pair<Point, Point> interval_type;
+        typedef typename base::value_type value_type;
+        typedef typename base::iterator iterator;
+        typedef typename base::const_iterator const_iterator;
+
+        /**
+         * iterates, in key order, over the intervals overlapping the query [lo, hi].
+         * it walks the tree along father pointers and skips every subtree whose largest right
+         * endpoint is less than lo; it stops at the first interval starting after hi.
+         */
+        class overlap_iterator {
+            friend class interval_map;
+
+        private:
+            interval_map *map_point;
+            node *iter_point;
+            Point lo, hi;
+
+            bool reaches(node *p) const { return p != nullptr && !map_point->point_cmp(p->max_end, lo); }
+
+            //p的子树中必有右端点不小于lo的区间，按中序找到其中第一个与查询相交的区间
+            //若先遇到左端点大于hi的区间，则之后不会再有相交的区间，返回nullptr
+            node *descend(node *p) const {
+                while (true) {
+                    if (reaches(p->left_son)) {
+                        p = p->left_son;
+                    } else if (map_point->point_cmp(hi, p->data.first.first)) {
+                        return nullptr;
+                    } else if (!map_point->point_cmp(p->data.first.second, lo)) {
+                        return p;
+                    } else { p = p->right_son; }//此时右子树必含右端点不小于lo的区间
+                }
+            }
+
+            //按中序找到p之后第一个与查询相交的区间
+            node *advance(node *p) const {
+                if (reaches(p->right_son)) { return descend(p->right_son); }
+                node *f = base::father_of(p);
+                while (f != nullptr) {
+                    if (f->left_son == p) {//p的子树已访问完，接下来为f及其右子树
+                        if (map_point->point_cmp(hi, f->data.first.first)) { return nullptr; }
+                        if (!map_point->point_cmp(f->data.first.second, lo)) { return f; }
+                        if (reaches(f->right_son)) { return descend(f->right_son); }
+                    }
+                    p = f;
+                    f = base::father_of(f);
+                }
+                return nullptr;
+            }
+
+            overlap_iterator(interval_map *map_point_, const Point &lo_, const Point &hi_)
+                    : map_point(map_point_), iter_point(nullptr), lo(lo_), hi(hi_) {
+                if (reaches(map_point->root)) { iter_point = descend(map_point->root); }
+            }
+
+        public:
+            overlap_iterator() : map_point(nullptr), iter_point(nullptr) {}
+
+            overlap_iterator operator++(int) {
+                overlap_iterator tmp = *this;
+                ++*this;
+                return tmp;
+            }
+
+            overlap_iterator &operator++() {
+                if (iter_point == nullptr) { throw invalid_iterator(); }
+                iter_point = advance(iter_point);
+                return *this;
+            }
+
+            value_type &operator*() const { return iter_point->data; }
+
+            value_type *operator->() const noexcept { return &(iter_point->data); }
+
+            //转换为map的迭代器，可用于erase
+            iterator position() const { return iterator(map_point, iter_point); }
+
+            //与查询区间的端点无关，到达末尾的迭代器均相等
+            bool operator==(const overlap_iterator &rhs) const { return iter_point == rhs.iter_point; }
+
+            bool operator!=(const overlap_iterator &rhs) const { return iter_point != rhs.iter_point; }
+        };
+
+        /**
+         * the lazy range of intervals overlapping a query, usable in range-based for.
+         */
+        class overlap_range {
+            friend class interval_map;
+
+        private:
+            overlap_iterator first;
+
+            explicit overlap_range(const overlap_iterator &first_) : first(first_) {}
+
+        public:
+            overlap_iterator begin() const { return first; }
+
+            overlap_iterator end() const { return overlap_iterator(); }
+
+            bool empty() const { return first == overlap_iterator(); }
+        };
+
+        /**
+         * read-only view of an overlap_iterator, returned by the const queries.
+         */
+        class const_overlap_iterator {
+            friend class interval_map;
+
+        private:
+            overlap_iterator it;
+
+        public:
+            const_overlap_iterator() {}
+
+            const_overlap_iterator(const overlap_iterator &other) : it(other) {}
+
+            const_overlap_iterator operator++(int) {
+                const_overlap_iterator tmp = *this;
+                ++it;
+                return tmp;
+            }
+
+            const_overlap_iterator &operator++() {
+                ++it;
+                return *this;
+            }
+
+            const value_type &operator*() const { return *it; }
+
+            const value_type *operator->() const noexcept { return it.operator->(); }
+
+            const_iterator position() const { return it.position(); }
+
+            bool operator==(const const_overlap_iterator &rhs) const { return it == rhs.it; }
+
+            bool operator!=(const const_overlap_iterator &rhs) const { return it != rhs.it; }
+        };
+
+        class const_overlap_range {
+            friend class interval_map;
+
+        private:
+            const_overlap_iterator first;
+
+            explicit const_overlap_range(const const_overlap_iterator &first_) : first(first_) {}
+
+        public:
+            const_overlap_iterator begin() const { return first; }
+
+            const_overlap_iterator end() const { return const_overlap_iterator(); }
+
+            bool empty() const { return first == const_overlap_iterator(); }
+        };
+
+    private:
+
+        Compare point_cmp;
+
+        //lo大于hi的区间不能插入
+        void check(const interval_type &key) const {
+            if (point_cmp(key.second, key.first)) { throw runtime_error(); }
+        }
+
+    public:
+
+        //以下插入方式均要求区间的lo不大于hi，否则抛出runtime_error，map不变
+        pair<iterator, bool> insert(const value_type &value) {
+            check(value.first);
+            return base::insert(value);
+        }
+
+        iterator insert(iterator hint, const value_type &value) {
+            check(value.first);
+            return base::insert(hint, value);
+        }
+
+        pair<iterator, bool> insert(const Point &lo, const Point &hi, const T &value) {
+            return insert(value_type(interval_type(lo, hi), value));
+        }
+
+        template<class... Args>
+        iterator emplace_hint(iterator hint, Args &&... args) {
+            return insert(hint, value_type(std::forward<Args>(args)...));
+        }
+
+        T &operator[](const interval_type &key) {
+            check(key);
+            return base::operator[](key);
+        }
+
+        const T &operator[](const interval_type &key) const { return this->at(key); }
+
+        //与[lo, hi]相交的所有区间，按(lo, hi)的顺序
+        overlap_range overlapping(const Point &lo, const Point &hi) {
+            return overlap_range(overlap_iterator(this, lo, hi));
+        }
+
+        //遍历不修改map，借用非const的迭代器，只提供只读的访问
+        const_overlap_range overlapping(const Point &lo, const Point &hi) const {
+            return const_overlap_range(overlap_iterator(const_cast<interval_map *>(this), lo, hi));
+        }
+
+        //包含点x的所有区间
+        overlap_range stabbing(const Point &x) { return overlapping(x, x); }
+
+        const_overlap_range stabbing(const Point &x) const { return overlapping(x, x); }
+
+        //是否存在与[lo, hi]相交的区间，O(log n)
+        bool overlaps(const Point &lo, const Point &hi) const { return !overlapping(lo, hi).empty(); }
+    };
+}
+
+#endif
@@ -7,7 +7,12 @@
 // only for std::less<T>
 #include <functional>
 #include <cstddef>
+#include <cstdint>
 #include <iostream>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
 #include "utility.hpp"
 #include "exceptions.hpp"
 
@@ -19,15 +24,56 @@ namespace sjtu {
     template<class T>
     struct my_iterator_traits;
 
+    /**
+     * the default augmentation of map: nodes carry nothing extra.
+     * an augmentation provides storage, a base class of every node holding the extra fields, and
+     * pull(p), which recomputes the extra fields of node p from p->data and the fields of its sons.
+     * map calls pull bottom-up on every node whose subtree has changed.
+     */
+    struct map_no_augment {
+        static const bool enabled = false;
+
+        struct storage {};
+
+        template<class Node>
+        inline static void pull(Node *) {}
+    };
+
+    /**
+     * used as the T of a map, makes nodes store the key only: the map is then a set whose value_type is const Key.
+     */
+    struct map_key_only {
+    };
+
+    /**
+     * the value stored in every node of map<Key, T>, and how to get its key.
+     */
+    template<class Key, class T>
+    struct map_value {
+        typedef pair<const Key, T> type;
+
+        inline static const Key &key_of(const type &value) { return value.first; }
+    };
+
+    template<class Key>
+    struct map_value<Key, map_key_only> {
+        typedef const Key type;
+
+        inline static const Key &key_of(const Key &value) { return value; }
+    };
+
     template<
             class Key,
             class T,
-            class Compare = std::less<Key>
+            class Compare = std::less<Key>,
+            class Augment = map_no_augment,
+            bool Multi = false
     >
     class map {
     public:
 
-        typedef pair<const Key, T> value_type;
+        //T为map_key_only时为const Key，即set；否则为pair<const Key, T>
+        typedef typename map_value<Key, T>::type value_type;
 
         class iterator;
 
@@ -43,7 +89,23 @@ namespace sjtu {
             red, black
         };
 
-        struct node {
+#ifdef SJTU_MAP_COMPACT_NODE
+        //紧凑节点：颜色存于父指针的最低位，且不存双链表的前后指针，前驱后继沿树上的父指针求得
+        struct node : public Augment::storage {
+            node *left_son;
+            node *right_son;
+            uintptr_t father_colour;
+            value_type data;
+
+            node(node *left_son_, node *right_son_, node *father_,
+                 value_type data_, colourT colour_ = black) : data(data_) {
+                left_son = left_son_;
+                right_son = right_son_;
+                father_colour = reinterpret_cast<uintptr_t>(father_) | colour_;
+            }
+        };
+#else
+        struct node : public Augment::storage {
             node *left_son;
             node *right_son;
             node *father;
@@ -63,6 +125,7 @@ namespace sjtu {
                 next = next_;
             }
         };
+#endif
 
         node *root;
         size_t siz = 0;
@@ -70,82 +133,563 @@ namespace sjtu {
         node *tail;
         Compare cmp;
 
-        void traverse_copy(node *now_root, node *other_root, node *&min, node *&max) {
-            //min_node表以now_root为根的节点中最小的节点；max_node同理
-            if (other_root->left_son != nullptr) {
-                now_root->left_son = new node(nullptr, nullptr, now_root,
-                                              other_root->left_son->data,
-                                              other_root->left_son->colour);
-                traverse_copy(now_root->left_son, other_root->left_son,
-                              min, now_root->pre);
-                now_root->pre->next = now_root;
-            } else { min = now_root; }
-            if (other_root->right_son != nullptr) {
-                now_root->right_son = new node(nullptr, nullptr, now_root,
-                                               other_root->right_son->data,
-                                               other_root->right_son->colour);
-                traverse_copy(now_root->right_son, other_root->right_son,
-                              now_root->next, max);
-                now_root->next->pre = now_root;
-            } else { max = now_root; }
+#ifdef SJTU_MAP_COMPACT_NODE
+        inline static node *father_of(node *p) {
+            return reinterpret_cast<node *>(p->father_colour & ~uintptr_t(1));
         }
 
-        void traverse_delete() {
-            node *p = head, *del = head;
+        inline static void set_father(node *p, node *father_) {
+            p->father_colour = reinterpret_cast<uintptr_t>(father_) | (p->father_colour & 1);
+        }
+
+        inline static colourT colour_of(node *p) { return colourT(p->father_colour & 1); }
+
+        inline static void set_colour(node *p, colourT colour_) {
+            p->father_colour = (p->father_colour & ~uintptr_t(1)) | colour_;
+        }
+
+        //中序后继：有右子树时为右子树的最小节点，否则为第一个从左子树上来的祖先
+        inline static node *next_of(node *p) {
+            if (p->right_son != nullptr) {
+                p = p->right_son;
+                while (p->left_son != nullptr) { p = p->left_son; }
+                return p;
+            }
+            node *f = father_of(p);
+            while (f != nullptr && f->right_son == p) {
+                p = f;
+                f = father_of(f);
+            }
+            return f;
+        }
+
+        inline static node *pre_of(node *p) {
+            if (p->left_son != nullptr) {
+                p = p->left_son;
+                while (p->right_son != nullptr) { p = p->right_son; }
+                return p;
+            }
+            node *f = father_of(p);
+            while (f != nullptr && f->left_son == p) {
+                p = f;
+                f = father_of(f);
+            }
+            return f;
+        }
+#else
+        inline static node *father_of(node *p) { return p->father; }
+
+        inline static void set_father(node *p, node *father_) { p->father = father_; }
+
+        inline static colourT colour_of(node *p) { return p->colour; }
+
+        inline static void set_colour(node *p, colourT colour_) { p->colour = colour_; }
+
+        inline static node *next_of(node *p) { return p->next; }
+
+        inline static node *pre_of(node *p) { return p->pre; }
+#endif
+
+        inline static const Key &key_of(const value_type &value) { return map_value<Key, T>::key_of(value); }
+
+        inline static void pull(node *p) { Augment::pull(p); }
+
+        //自p起沿父指针向上，重新计算路径上各节点的附加信息
+        inline static void pull_path(node *p) {
+            if (!Augment::enabled) { return; }
+            for (; p != nullptr; p = father_of(p)) { Augment::pull(p); }
+        }
+
+        //复制节点q（含附加信息），挂在father下
+        inline static node *clone_node(node *q, node *father) {
+            node *p = new node(nullptr, nullptr, father, q->data, colour_of(q));
+            static_cast<typename Augment::storage &>(*p) = static_cast<const typename Augment::storage &>(*q);
+            return p;
+        }
+
+        inline static void prefetch(const node *p) {
+#ifdef __GNUC__
+            __builtin_prefetch(p);
+#else
+            (void) p;
+#endif
+        }
+
+        static const size_t batch_group = 16;//批量查找时同时推进的查找个数
+
+        //交错推进keys中m（不超过batch_group）个查找，每一步为各查找下一次访问的节点发出预取，
+        //使各查找的缓存缺失相互重叠。found[i]为keys[i]对应的节点，不存在时为nullptr
+        void find_group(const Key *keys, size_t m, node **found) const {
+            node *cur[batch_group];
+            size_t lane[batch_group], active = 0;//lane中为尚未结束的查找
+            for (size_t i = 0; i < m; ++i) {
+                found[i] = nullptr;
+                cur[i] = root;
+                if (root != nullptr) { lane[active++] = i; }
+            }
+            while (active > 0) {
+                size_t kept = 0;
+                for (size_t j = 0; j < active; ++j) {
+                    size_t i = lane[j];
+                    node *p = cur[i];
+                    if (cmp(keys[i], key_of(p->data))) {
+                        p = p->left_son;
+                    } else if (cmp(key_of(p->data), keys[i])) {
+                        p = p->right_son;
+                    } else {
+                        found[i] = p;
+                        continue;
+                    }
+                    if (p != nullptr) {
+                        prefetch(p);
+                        cur[i] = p;
+                        lane[kept++] = i;
+                    }
+                }
+                active = kept;
+            }
+        }
+
+        //在以p为根的子树中查找key，不存在时返回nullptr。Multi时返回其中第一个
+        node *find_in(node *p, const Key &key) const {
+            node *found = nullptr;
             while (p != nullptr) {
-                p = p->next;
-                delete del;
-                del = p;
+                if (cmp(key, key_of(p->data))) {
+                    p = p->left_son;
+                } else if (cmp(key_of(p->data), key)) {
+                    p = p->right_son;
+                } else {
+                    if (!Multi) { return p; }
+                    found = p;
+                    p = p->left_son;//继续向左寻找第一个
+                }
             }
+            return found;
+        }
+
+        //Multi时返回与p的key相同的第一个节点
+        node *first_equal(node *p) const {
+            if (!Multi || p == nullptr) { return p; }
+            for (node *q = pre_of(p); q != nullptr && !cmp(key_of(q->data), key_of(p->data)); q = pre_of(q)) { p = q; }
+            return p;
+        }
+
+        //第一个key不小于key的节点，不存在时返回nullptr
+        node *lower_bound_of(const Key &key) const {
+            node *result = nullptr;
+            for (node *p = root; p != nullptr;) {
+                if (cmp(key_of(p->data), key)) { p = p->right_son; }
+                else {
+                    result = p;
+                    p = p->left_son;
+                }
+            }
+            return result;
+        }
+
+        //第一个key大于key的节点，不存在时返回nullptr
+        node *upper_bound_of(const Key &key) const {
+            node *result = nullptr;
+            for (node *p = root; p != nullptr;) {
+                if (!cmp(key, key_of(p->data))) { p = p->right_son; }
+                else {
+                    result = p;
+                    p = p->left_son;
+                }
+            }
+            return result;
+        }
+
+        //释放以右儿子指针串起的节点
+        static void delete_vine(node *vine) {
+            while (vine != nullptr) {
+                node *p = vine;
+                vine = vine->right_son;
+                delete p;
+            }
+        }
+
+        //自finger出发查找key，不存在时返回nullptr
+        //先比较finger在中序中的下一个（或上一个）节点；再沿父指针上溯，直到父节点的key越过key，
+        //此时key若存在必在当前节点的子树中，由此向下查找。key与finger在中序中相距d时，
+        //上溯与下降通常只需O(log d)步；二者分处某个高层祖先的两侧时，最坏仍为O(log n)
+        node *find_from(node *finger, const Key &key) const {
+            node *p = finger;
+            if (cmp(key_of(p->data), key)) {//key在finger之后
+                node *q = next_of(p);
+                if (q == nullptr || !cmp(key_of(q->data), key)) {
+                    return (q != nullptr && !cmp(key, key_of(q->data)) ? q : nullptr);
+                }
+                p = q;
+                while (true) {
+                    node *f = father_of(p);
+                    if (f == nullptr || cmp(key, key_of(f->data))) { break; }
+                    if (!cmp(key_of(f->data), key)) { return f; }
+                    p = f;
+                }
+            } else if (cmp(key, key_of(p->data))) {//key在finger之前
+                node *q = pre_of(p);
+                if (q == nullptr || !cmp(key, key_of(q->data))) {
+                    return (q != nullptr && !cmp(key_of(q->data), key) ? q : nullptr);
+                }
+                p = q;
+                while (true) {
+                    node *f = father_of(p);
+                    if (f == nullptr || cmp(key_of(f->data), key)) { break; }
+                    if (!cmp(key, key_of(f->data))) { return f; }
+                    p = f;
+                }
+            } else { return p; }
+            return find_in(p, key);
+        }
+
+        //定义SJTU_MAP_PARALLEL且元素个数不少于此值时，多线程复制与释放。复制时各线程并发调用Key、T的复制构造函数，
+        //二者的复制须可以并发进行，因此默认关闭
+        static const size_t parallel_threshold = 1 << 16;
+        static const int max_cut_depth = 6;//多线程时在此深度以内切分子树，至多64棵
+
+        struct cut_task {
+            node *other_root;//待复制的子树
+            node *father;//复制出的子树挂在father下
+            bool is_left;
+            node *min;
+            node *max;
+        };//多线程复制时，每棵被切分出的子树为一个任务
+
+        //复制以other_root为根的子树并挂在father下，返回新子树的根
+        //两棵树沿父指针同步遍历，既不递归也不用栈
+        static node *clone_tree(node *other_root, node *father) {
+            node *now_root = clone_node(other_root, father);
+            node *p = now_root, *q = other_root;
+            try {
+                while (true) {
+                    if (q->left_son != nullptr && p->left_son == nullptr) {
+                        p = p->left_son = clone_node(q->left_son, p);
+                        q = q->left_son;
+                    } else if (q->right_son != nullptr && p->right_son == nullptr) {
+                        p = p->right_son = clone_node(q->right_son, p);
+                        q = q->right_son;
+                    } else if (q == other_root) {
+                        break;
+                    } else {//该子树已复制完，回到父节点
+                        p = father_of(p);
+                        q = father_of(q);
+                    }
+                }
+            } catch (...) {
+                delete_tree(now_root);
+                throw;
+            }
+            return now_root;
+        }
+
+        //后序释放以sub_root为根的子树，不递归也不用栈
+        static void delete_tree(node *sub_root) {
+            node *p = sub_root;
+            while (p != nullptr) {
+                if (p->left_son != nullptr) { p = p->left_son; }
+                else if (p->right_son != nullptr) { p = p->right_son; }
+                else {//p已为叶节点，删除后回到父节点
+                    node *f = (p == sub_root ? nullptr : father_of(p));
+                    if (f != nullptr) {
+                        if (f->left_son == p) { f->left_son = nullptr; }
+                        else { f->right_son = nullptr; }
+                    }
+                    delete p;
+                    p = f;
+                }
+            }
+        }
+
+#ifndef SJTU_MAP_COMPACT_NODE
+        //按中序连接以sub_root为根的子树的双链表，返回其中的最小、最大节点
+        static void link_tree(node *sub_root, node *&min, node *&max) {
+            node *p = sub_root, *prev = nullptr;
+            while (p->left_son != nullptr) { p = p->left_son; }
+            min = p;
+            while (p != nullptr) {
+                p->pre = prev;
+                if (prev != nullptr) { prev->next = p; }
+                prev = p;
+                if (p->right_son != nullptr) {
+                    p = p->right_son;
+                    while (p->left_son != nullptr) { p = p->left_son; }
+                } else {
+                    while (p != sub_root && father_of(p)->right_son == p) { p = father_of(p); }
+                    p = (p == sub_root ? nullptr : father_of(p));
+                }
+            }
+            max = prev;
+            max->next = nullptr;
+        }
+
+        //按中序连接上层节点与各子树（其内部已连好），tasks与中序中子树的先后顺序一致
+        static void stitch_top(node *p, int depth, int cut_depth, cut_task *tasks, int &index,
+                               node *&prev, node *&first) {
+            if (p == nullptr) { return; }
+            node *min = p, *max = p;
+            if (depth == cut_depth) {
+                min = tasks[index].min;
+                max = tasks[index].max;
+                ++index;
+            } else { stitch_top(p->left_son, depth + 1, cut_depth, tasks, index, prev, first); }
+            min->pre = prev;
+            if (prev != nullptr) { prev->next = min; }
+            else { first = min; }
+            prev = max;
+            if (depth != cut_depth) { stitch_top(p->right_son, depth + 1, cut_depth, tasks, index, prev, first); }
+        }
+#endif
+
+        //复制深度小于cut_depth的上层节点，深度为cut_depth的子树按从左到右的顺序记为任务
+        static node *clone_top(node *q, node *father, bool is_left, int depth, int cut_depth,
+                               cut_task *tasks, int &task_count) {
+            if (depth == cut_depth) {
+                tasks[task_count].other_root = q;
+                tasks[task_count].father = father;
+                tasks[task_count].is_left = is_left;
+                ++task_count;
+                return nullptr;
+            }
+            node *p = clone_node(q, father);
+            try {
+                if (q->left_son != nullptr) {
+                    p->left_son = clone_top(q->left_son, p, true, depth + 1, cut_depth, tasks, task_count);
+                }
+                if (q->right_son != nullptr) {
+                    p->right_son = clone_top(q->right_son, p, false, depth + 1, cut_depth, tasks, task_count);
+                }
+            } catch (...) {
+                delete_tree(p);
+                throw;
+            }
+            return p;
+        }
+
+        //n个元素的复制或释放可用的线程数，为1时在当前线程中进行
+        static unsigned parallel_threads(size_t n) {
+#ifdef SJTU_MAP_PARALLEL
+            unsigned threads = std::thread::hardware_concurrency();
+            if (n >= parallel_threshold && threads > 1) { return threads; }
+#else
+            (void) n;
+#endif
+            return 1;
+        }
+
+        inline static int cut_depth_of(unsigned threads) {
+            int depth = 1;
+            while ((1u << depth) < threads * 4 && depth < max_cut_depth) { ++depth; }//任务数取线程数的4倍左右以均衡负载
+            return depth;
+        }
+
+        //先复制上层节点，再由多个线程并行复制下层的各棵子树，最后连接双链表
+        void parallel_copy(node *other_root, unsigned threads) {
+            int cut_depth = cut_depth_of(threads), task_count = 0;
+            cut_task tasks[1 << max_cut_depth];
+            root = clone_top(other_root, nullptr, false, 0, cut_depth, tasks, task_count);
+            std::atomic<int> next_task(0);
+            std::exception_ptr error = nullptr;
+            std::mutex error_lock;
+            auto work = [&]() {
+                int i;
+                while ((i = next_task++) < task_count) {
+                    try {
+                        node *sub_root = clone_tree(tasks[i].other_root, tasks[i].father);
+                        if (tasks[i].is_left) { tasks[i].father->left_son = sub_root; }
+                        else { tasks[i].father->right_son = sub_root; }
+#ifndef SJTU_MAP_COMPACT_NODE
+                        link_tree(sub_root, tasks[i].min, tasks[i].max);
+#endif
+                    } catch (...) {
+                        std::lock_guard<std::mutex> guard(error_lock);
+                        error = std::current_exception();
+                    }
+                }
+            };
+            std::thread workers[1 << max_cut_depth];
+            unsigned worker_count = 0;
+            for (; worker_count + 1 < threads && int(worker_count) < task_count; ++worker_count) {
+                try {
+                    workers[worker_count] = std::thread(work);
+                } catch (...) { break; }//无法创建线程时，余下的任务由已有的线程完成
+            }
+            work();
+            for (unsigned i = 0; i < worker_count; ++i) { workers[i].join(); }
+            if (error != nullptr) {
+                delete_tree(root);
+                head = tail = root = nullptr;
+                std::rethrow_exception(error);
+            }
+#ifndef SJTU_MAP_COMPACT_NODE
+            int index = 0;
+            node *prev = nullptr;
+            stitch_top(root, 0, cut_depth, tasks, index, prev, head);
+            tail = prev;
+            tail->next = nullptr;
+#endif
+        }
+
+        //复制other的所有节点，调用前当前map须为空。复制抛出异常时map仍为空，siz在复制成功后才写入
+        void copy_from(const map &other) {
+            head = tail = root = nullptr;
+            siz = 0;
+            if (other.root == nullptr) { return; }
+            size_t n = other.size();
+            unsigned threads = parallel_threads(n);
+            if (threads > 1) {
+                parallel_copy(other.root, threads);
+            } else {
+                root = clone_tree(other.root, nullptr);
+#ifndef SJTU_MAP_COMPACT_NODE
+                link_tree(root, head, tail);
+#endif
+            }
+#ifdef SJTU_MAP_COMPACT_NODE
+            head = tail = root;
+            while (head->left_son != nullptr) { head = head->left_son; }
+            while (tail->right_son != nullptr) { tail = tail->right_son; }
+#endif
+            siz = n;
+        }
+
+        //切下深度为cut_depth的各棵子树，记入subs
+        static void cut_subtrees(node *p, int depth, int cut_depth, node **subs, int &task_count) {
+            if (depth + 1 == cut_depth) {
+                if (p->left_son != nullptr) { subs[task_count++] = p->left_son; }
+                if (p->right_son != nullptr) { subs[task_count++] = p->right_son; }
+                p->left_son = p->right_son = nullptr;
+                return;
+            }
+            if (p->left_son != nullptr) { cut_subtrees(p->left_son, depth + 1, cut_depth, subs, task_count); }
+            if (p->right_son != nullptr) { cut_subtrees(p->right_son, depth + 1, cut_depth, subs, task_count); }
+        }
+
+        //释放以now_root为根的整棵树。定义SJTU_MAP_PARALLEL且规模较大时，
+        //先切下深处的各棵子树由多个线程并行释放，再释放上层节点
+        static void release_tree(node *now_root, size_t now_siz) {
+            if (now_root == nullptr) { return; }
+            unsigned threads = parallel_threads(now_siz);
+            if (threads > 1) {
+                parallel_release(now_root, threads);
+            } else { delete_tree(now_root); }
+        }
+
+        static void parallel_release(node *now_root, unsigned threads) {
+            int cut_depth = cut_depth_of(threads), task_count = 0;
+            node *subs[1 << max_cut_depth];
+            cut_subtrees(now_root, 0, cut_depth, subs, task_count);
+            std::atomic<int> next_task(0);
+            auto work = [&]() {
+                int i;
+                while ((i = next_task++) < task_count) { delete_tree(subs[i]); }
+            };
+            std::thread workers[1 << max_cut_depth];
+            unsigned worker_count = 0;
+            for (; worker_count + 1 < threads && int(worker_count) < task_count; ++worker_count) {
+                try {
+                    workers[worker_count] = std::thread(work);
+                } catch (...) { break; }//无法创建线程时，余下的子树由已有的线程释放
+            }
+            work();
+            for (unsigned i = 0; i < worker_count; ++i) { workers[i].join(); }
+            delete_tree(now_root);
+        }
+
+        void traverse_delete() {
+            release_tree(root, siz);
+        }
+
+        //将自cur起以right_son串起的n个有序节点建成平衡的子树并返回其根，cur随之后移
+        //深度为red_depth的节点（即不满的最后一层）染红，其余染黑
+        static node *build_balanced(node *&cur, size_t n, int depth, int red_depth) {
+            if (n == 0) { return nullptr; }
+            size_t left_n = (n - 1) / 2;
+            node *left = build_balanced(cur, left_n, depth + 1, red_depth);
+            node *p = cur;
+            cur = cur->right_son;
+            p->left_son = left;
+            if (left != nullptr) { set_father(left, p); }
+            p->right_son = build_balanced(cur, n - 1 - left_n, depth + 1, red_depth);
+            if (p->right_son != nullptr) { set_father(p->right_son, p); }
+            set_colour(p, depth == red_depth ? red : black);
+            pull(p);
+            return p;
+        }
+
+        //用以right_son串起的n个有序节点建树，O(n)，调用前当前map须为空
+        void build_from_vine(node *vine, size_t n) {
+            siz = n;
+            head = tail = root = nullptr;
+            if (n == 0) { return; }
+            int full_depth = 0;//满的层数
+            while ((size_t(2) << full_depth) - 1 <= n) { ++full_depth; }
+            root = build_balanced(vine, n, 0, full_depth);
+            set_father(root, nullptr);
+#ifndef SJTU_MAP_COMPACT_NODE
+            link_tree(root, head, tail);
+#else
+            head = tail = root;
+            while (head->left_son != nullptr) { head = head->left_son; }
+            while (tail->right_son != nullptr) { tail = tail->right_son; }
+#endif
         }
 
         void rotate_LL(node *root_now) {
             node *root_new = root_now->left_son;
             root_now->left_son = root_new->right_son;
-            if (root_now->left_son != nullptr) { root_now->left_son->father = root_now; }
+            if (root_now->left_son != nullptr) { set_father(root_now->left_son, root_now); }
             root_new->right_son = root_now;
-            root_new->father = root_now->father;
-            root_now->father = root_new;
-            if (root_new->father != nullptr) {
-                if (root_new->father->right_son == root_now) {
-                    root_new->father->right_son = root_new;
-                } else { root_new->father->left_son = root_new; }
+            set_father(root_new, father_of(root_now));
+            set_father(root_now, root_new);
+            if (father_of(root_new) != nullptr) {
+                if (father_of(root_new)->right_son == root_now) {
+                    father_of(root_new)->right_son = root_new;
+                } else { father_of(root_new)->left_son = root_new; }
             }
             if (root_now == root) { root = root_new; }
+            pull(root_now);//旋转前后子树的元素不变，只需更新这两个节点
+            pull(root_new);
         }
 
         void rotate_RR(node *root_now) {
             node *root_new = root_now->right_son;
             root_now->right_son = root_new->left_son;
-            if (root_now->right_son != nullptr) { root_now->right_son->father = root_now; }
+            if (root_now->right_son != nullptr) { set_father(root_now->right_son, root_now); }
             root_new->left_son = root_now;
-            root_new->father = root_now->father;
-            root_now->father = root_new;
-            if (root_new->father != nullptr) {
-                if (root_new->father->right_son == root_now) {
-                    root_new->father->right_son = root_new;
-                } else { root_new->father->left_son = root_new; }
+            set_father(root_new, father_of(root_now));
+            set_father(root_now, root_new);
+            if (father_of(root_new) != nullptr) {
+                if (father_of(root_new)->right_son == root_now) {
+                    father_of(root_new)->right_son = root_new;
+                } else { father_of(root_new)->left_son = root_new; }
             }
             if (root_now == root) { root = root_new; }
+            pull(root_now);//旋转前后子树的元素不变，只需更新这两个节点
+            pull(root_new);
         }
 
         void swap_node(node *&one, node *&two) {
-            swap(one->father, two->father);
-            if (one->father != nullptr) {
-                if (one->father->left_son == two) { one->father->left_son = one; }
-                else { one->father->right_son = one; }
+            node *father_tmp = father_of(one);
+            set_father(one, father_of(two));
+            set_father(two, father_tmp);
+            if (father_of(one) != nullptr) {
+                if (father_of(one)->left_son == two) { father_of(one)->left_son = one; }
+                else { father_of(one)->right_son = one; }
             }
-            if (two->father != nullptr) {
-                if (two->father->left_son == one) { two->father->left_son = two; }
-                else { two->father->right_son = two; }
+            if (father_of(two) != nullptr) {
+                if (father_of(two)->left_son == one) { father_of(two)->left_son = two; }
+                else { father_of(two)->right_son = two; }
             }
             swap(one->left_son, two->left_son);
-            if (one->left_son != nullptr) { one->left_son->father = one; }
-            if (two->left_son != nullptr) { two->left_son->father = two; }
+            if (one->left_son != nullptr) { set_father(one->left_son, one); }
+            if (two->left_son != nullptr) { set_father(two->left_son, two); }
             swap(one->right_son, two->right_son);
-            if (one->right_son != nullptr) { one->right_son->father = one; }
-            if (two->right_son != nullptr) { two->right_son->father = two; }
-            swap(one->colour, two->colour);
+            if (one->right_son != nullptr) { set_father(one->right_son, one); }
+            if (two->right_son != nullptr) { set_father(two->right_son, two); }
+            colourT colour_tmp = colour_of(one);
+            set_colour(one, colour_of(two));
+            set_colour(two, colour_tmp);
             if (one == root) { root = two; }
             else if (two == root) { root = one; }
         }
@@ -157,30 +701,49 @@ namespace sjtu {
             two = tmp;
         }
 
-        inline void adjust_insert_link(node *now_node) {//插入节点后，前后节点、头尾节点的维护
+        inline void adjust_insert_link(node *now_node) {//插入叶节点后，前后节点、头尾节点的维护
+#ifdef SJTU_MAP_COMPACT_NODE
+            node *f = father_of(now_node);
+            if (f == head && f->left_son == now_node) { head = now_node; }
+            if (f == tail && f->right_son == now_node) { tail = now_node; }
+#else
+            if (is_left_son_of_father(now_node)) {
+                now_node->pre = father_of(now_node)->pre;
+                now_node->next = father_of(now_node);
+            } else {
+                now_node->pre = father_of(now_node);
+                now_node->next = father_of(now_node)->next;
+            }
             if (now_node->pre != nullptr) {
                 now_node->pre->next = now_node;
             } else { head = now_node; }
             if (now_node->next != nullptr) {
                 now_node->next->pre = now_node;
             } else { tail = now_node; }
+#endif
         }
 
         inline void adjust_delete_link(node *now_node) {//删除节点前，前后节点、头尾节点的维护
+#ifdef SJTU_MAP_COMPACT_NODE
+            //头尾节点至多有一个儿子，不会与替身交换位置，此时仍可沿树求前驱后继
+            if (now_node == head) { head = next_of(now_node); }
+            if (now_node == tail) { tail = pre_of(now_node); }
+#else
             if (now_node->pre != nullptr) {
                 now_node->pre->next = now_node->next;
             } else { head = now_node->next; }
             if (now_node->next != nullptr) {
                 now_node->next->pre = now_node->pre;
             } else { tail = now_node->pre; }
+#endif
         }
 
         inline static bool is_left_son_of_father(node *p) {
-            return (p->father != nullptr && p->father->left_son == p);
+            return (father_of(p) != nullptr && father_of(p)->left_son == p);
         }
 
         inline static bool have_red_left_son(node *p) {
-            return (p->left_son != nullptr && p->left_son->colour == red);
+            return (p->left_son != nullptr && colour_of(p->left_son) == red);
         }
 
         inline static bool have_null_left_son(node *p) {
@@ -188,7 +751,7 @@ namespace sjtu {
         }
 
         inline static bool have_red_right_son(node *p) {
-            return (p->right_son != nullptr && p->right_son->colour == red);
+            return (p->right_son != nullptr && colour_of(p->right_son) == red);
         }
 
         inline static bool have_null_right_son(node *p) {
@@ -251,6 +814,8 @@ namespace sjtu {
                 iter_point = other.iter_point;
             }
 
+            iterator &operator=(const iterator &other) = default;
+
             iterator operator++(int) {
                 iterator tmp(*this);
                 ++(*this);
@@ -259,7 +824,7 @@ namespace sjtu {
 
             iterator &operator++() {
                 if (iter_point == nullptr) { throw invalid_iterator(); }
-                iter_point = iter_point->next;
+                iter_point = map::next_of(iter_point);
                 return *this;
             }
 
@@ -270,11 +835,11 @@ namespace sjtu {
             }
 
             iterator &operator--() {
-                if (map_point->siz == 0 || iter_point == map_point->head) {
+                if (map_point->root == nullptr || iter_point == map_point->head) {
                     throw invalid_iterator();
                 }
                 if (iter_point == nullptr) { iter_point = map_point->tail; }
-                else { iter_point = iter_point->pre; }
+                else { iter_point = map::pre_of(iter_point); }
                 return *this;
             }
 
@@ -335,6 +900,8 @@ namespace sjtu {
             const_iterator(const const_iterator &other) :
                     map_point(other.get_map_point()), iter_point(other.get_iter_point()) {}
 
+            const_iterator &operator=(const const_iterator &other) = default;
+
             const_iterator(const iterator &other) :
                     map_point(other.get_map_point()), iter_point(other.get_iter_point()) {}
 
@@ -346,7 +913,7 @@ namespace sjtu {
 
             const_iterator &operator++() {
                 if (iter_point == nullptr) { throw invalid_iterator(); }
-                iter_point = iter_point->next;
+                iter_point = map::next_of(iter_point);
                 return *this;
             }
 
@@ -357,11 +924,11 @@ namespace sjtu {
             }
 
             const_iterator &operator--() {
-                if (map_point->siz == 0 || iter_point == map_point->head) {
+                if (map_point->root == nullptr || iter_point == map_point->head) {
                     throw invalid_iterator();
                 }
                 if (iter_point == nullptr) { iter_point = map_point->tail; }
-                else { iter_point = iter_point->pre; }
+                else { iter_point = map::pre_of(iter_point); }
                 return *this;
             }
 
@@ -400,14 +967,7 @@ namespace sjtu {
         }
 
         map(const map &other) {
-            siz = other.siz;
-            if (other.root != nullptr) {
-                root = new node(nullptr, nullptr, nullptr, other.root->data, black);
-                head = tail = root;
-                traverse_copy(root, other.root, head, tail);
-            } else {
-                head = tail = root = nullptr;
-            }
+            copy_from(other);
         }
 
         map(map &&other) {
@@ -415,29 +975,28 @@ namespace sjtu {
             head = other.head;
             tail = other.tail;
             root = other.root;
-            other.head = other.tail = other.tail = nullptr;
+            other.head = other.tail = other.root = nullptr;
+            other.siz = 0;
         }
 
         map &operator=(const map &other) {
             if (&other == this) { return *this; }
             traverse_delete();
-            if (other.root != nullptr) {
-                root = new node(nullptr, nullptr, nullptr, other.root->data, black);
-                head = tail = root;
-                traverse_copy(root, other.root, head, tail);
-            } else {
-                head = tail = root = nullptr;
-            }
-            siz = other.siz;
+            head = tail = root = nullptr;
+            siz = 0;
+            copy_from(other);
             return *this;
         }
 
         map &operator=(map &&other) {
+            if (&other == this) { return *this; }
+            traverse_delete();
             siz = other.siz;
             head = other.head;
             tail = other.tail;
             root = other.root;
-            other.head = other.tail = other.tail = nullptr;
+            other.head = other.tail = other.root = nullptr;
+            other.siz = 0;
             return *this;
         }
 
@@ -452,9 +1011,9 @@ namespace sjtu {
             node *p = root;
             if (root == nullptr) { throw index_out_of_bound(); }
             while (p != nullptr) {
-                if (cmp(key, p->data.first)) {
+                if (cmp(key, key_of(p->data))) {
                     p = p->left_son;
-                } else if (cmp(p->data.first, key)) {
+                } else if (cmp(key_of(p->data), key)) {
                     p = p->right_son;
                 } else { return p->data.second; }
             }
@@ -465,9 +1024,9 @@ namespace sjtu {
             node *p = root;
             if (root == nullptr) { throw index_out_of_bound(); }
             while (p != nullptr) {
-                if (cmp(key, p->data.first)) {
+                if (cmp(key, key_of(p->data))) {
                     p = p->left_son;
-                } else if (cmp(p->data.first, key)) {
+                } else if (cmp(key_of(p->data), key)) {
                     p = p->right_son;
                 } else { return p->data.second; }
             }
@@ -494,7 +1053,7 @@ namespace sjtu {
 
         const_iterator cend() const { return const_iterator(this, nullptr); }
 
-        bool empty() const { return siz == 0; }
+        bool empty() const { return root == nullptr; }
 
         size_t size() const { return siz; }
 
@@ -504,47 +1063,355 @@ namespace sjtu {
             head = tail = root = nullptr;
         }
 
+        //map立即变为空，原有节点交给后台线程释放，用于释放很大的map而不阻塞当前线程
+        //元素的析构在后台线程中进行；无法创建线程时退化为在当前线程释放
+        void clear_deferred() {
+            node *old_root = root;
+            size_t old_siz = siz;
+            siz = 0;
+            head = tail = root = nullptr;
+            if (old_root == nullptr) { return; }
+            try {
+                std::thread(release_tree, old_root, old_siz).detach();
+            } catch (...) { release_tree(old_root, old_siz); }//无法创建线程时在当前线程释放
+        }
+
+        //用[first, last)中的元素替换map的全部内容，元素须按key严格递增（Multi时为不减），否则抛出runtime_error且map不变
+        //不做查找和旋转，O(n)建树，用于从有序的数据（如map_image）快速重建
+        template<class InputIterator>
+        void assign_sorted(InputIterator first, InputIterator last) {
+            node *vine = nullptr, *vine_tail = nullptr;
+            size_t n = 0;
+            try {
+                for (; first != last; ++first) {
+                    node *p = new node(nullptr, nullptr, nullptr, *first);
+                    if (vine_tail != nullptr && (Multi ? cmp(key_of(p->data), key_of(vine_tail->data))
+                                                       : !cmp(key_of(vine_tail->data), key_of(p->data)))) {
+                        delete p;
+                        throw runtime_error();
+                    }
+                    if (vine_tail == nullptr) { vine = p; }
+                    else { vine_tail->right_son = p; }
+                    vine_tail = p;
+                    ++n;
+                }
+            } catch (...) {
+                delete_vine(vine);
+                throw;
+            }
+            clear();
+            build_from_vine(vine, n);
+        }
+
+        //按key归并a与b，以复制的节点替换当前map的内容，O(|a| + |b|)，当前map可以是a或b
+        //只在a中的元素在take_a时保留，只在b中的在take_b时保留，两边都有的在take_both时保留a中的
+        //Multi时相同的key逐个配对，与std::set_union等的语义一致
+        void merge_from(const map &a, const map &b, bool take_a, bool take_b, bool take_both) {
+            node *vine = nullptr, *vine_tail = nullptr, *p = a.head, *q = b.head;
+            size_t n = 0;
+            try {
+                while ((p != nullptr || q != nullptr) && (p != nullptr || take_b) && (q != nullptr || take_a)) {
+                    node *taken = nullptr;
+                    if (q == nullptr || (p != nullptr && cmp(key_of(p->data), key_of(q->data)))) {
+                        if (take_a) { taken = p; }
+                        p = next_of(p);
+                    } else if (p == nullptr || cmp(key_of(q->data), key_of(p->data))) {
+                        if (take_b) { taken = q; }
+                        q = next_of(q);
+                    } else {
+                        if (take_both) { taken = p; }
+                        p = next_of(p);
+                        q = next_of(q);
+                    }
+                    if (taken == nullptr) { continue; }
+                    node *copy = new node(nullptr, nullptr, nullptr, taken->data);
+                    if (vine_tail == nullptr) { vine = copy; }
+                    else { vine_tail->right_son = copy; }
+                    vine_tail = copy;
+                    ++n;
+                }
+            } catch (...) {
+                delete_vine(vine);
+                throw;
+            }
+            clear();
+            build_from_vine(vine, n);
+        }
+
+        //将key不小于key的元素移入返回的map，当前map只保留key小于key的元素
+        //切分本身为O(log n)，另需O(min(k, n - k))从两端数出较少一边的元素个数，k为移出的元素个数
+        map split(const Key &key) { return split_at(lower_bound_of(key)); }
+
+        //first及中序在其后的节点个数。同时从head向后、从tail向前数，先到达first的一边决定结果，O(min(k, n - k))
+        size_t count_from(node *first) const {
+            node *l = head, *r = tail;
+            for (size_t before = 0, after = 1;; ++before, ++after) {
+                if (l == first) { return siz - before; }
+                if (r == first) { return after; }
+                l = next_of(l);
+                r = pre_of(r);
+            }
+        }
+
+        //将节点first及中序在其后的元素移入返回的map，first为nullptr时返回空map，两边的元素个数保持准确
+        map split_at(node *first) {
+            if (first == nullptr) { return map(); }
+            size_t moved = count_from(first), kept = siz - moved;
+            map other(detach_from(first));
+            other.siz = moved;
+            siz = kept;
+            return other;
+        }
+
+        //split_at的切分部分，O(log n)，不维护两边的siz，由调用者设置
+        map detach_from(node *first) {
+            if (first == nullptr) { return map(); }
+            if (first == head) { return map(static_cast<map &&>(*this)); }
+            node *last = pre_of(first), *old_tail = tail, *left, *right;
+            int left_bh, right_bh;
+            split_tree_at(first, left, left_bh, right, right_bh);
+            map other;
+            root = left;
+            tail = last;
+            other.root = right;
+            other.head = first;
+            other.tail = old_tail;
+#ifndef SJTU_MAP_COMPACT_NODE
+            last->next = nullptr;
+            first->pre = nullptr;
+#endif
+            return other;
+        }
+
+        //将other的全部元素移入当前map，other随后为空。两者的key须不相交且有序，即other的元素均大于、
+        //或均小于当前map的元素（Multi时允许边界上的key相等），否则抛出runtime_error。O(log n)
+        //先摘下较小一方的最大节点，再以它为中间节点合并两棵树
+        void join(map &other) {
+            if (other.root == nullptr) { return; }
+            if (&other == this) { throw runtime_error(); }
+            if (root == nullptr) {
+                *this = static_cast<map &&>(other);
+                return;
+            }
+            bool other_right = (Multi ? !cmp(key_of(other.head->data), key_of(tail->data))
+                                      : cmp(key_of(tail->data), key_of(other.head->data)));
+            if (!other_right && (Multi ? cmp(key_of(head->data), key_of(other.tail->data))
+                                       : !cmp(key_of(other.tail->data), key_of(head->data)))) {
+                throw runtime_error();
+            }
+            size_t total = siz + other.siz;
+            map &left = (other_right ? *this : other), &right = (other_right ? other : *this);
+            node *k = left.tail;
+            left.unlink_node(k);
+            node *left_root = left.root, *left_head = left.head, *left_tail = left.tail;
+            node *right_root = right.root, *right_head = right.head, *right_tail = right.tail;
+            other.root = other.head = other.tail = nullptr;
+            other.siz = 0;
+            join_trees(left_root, black_height_of(left_root), k, right_root, black_height_of(right_root));
+            head = (left_head != nullptr ? left_head : k);
+            tail = right_tail;
+#ifndef SJTU_MAP_COMPACT_NODE
+            k->pre = left_tail;
+            if (left_tail != nullptr) { left_tail->next = k; }
+            k->next = right_head;
+            right_head->pre = k;
+#else
+            (void) left_tail;
+            (void) right_head;
+#endif
+            siz = total;
+        }
+
         //insert an element.
         //return a pair, the first of the pair is
         //the iterator to the new element (or the element that prevented the insertion),
         //the second one is true if insert successfully, or false.
         pair<iterator, bool> insert(const value_type &value) {
-            if (siz == 0) {
+            if (root == nullptr) {
                 head = tail = root = new node(nullptr, nullptr, nullptr, value, black);
-                ++siz;
+                pull(root);
+                siz = 1;
                 return pair<iterator, bool>(iterator(this, root), true);
             }
-            node *p = root, *p_insert;
-            bool flag = false;
-            while (true) {//寻找要插入的位置并插入,最后break时p为插入节点的父节点
-                if (cmp(value.first, p->data.first)) {
+            node *p = root;
+            while (true) {//寻找要插入的位置并插入,p为插入节点的父节点
+                if (cmp(key_of(value), key_of(p->data))) {
                     if (have_null_left_son(p)) {
-                        p_insert = p->left_son = new node(nullptr, nullptr, p,
-                                                          value, red, p->pre, p);
-                        ++siz;
-                        adjust_insert_link(p_insert);//双链表中插入节点
-                        break;
+                        return pair<iterator, bool>(iterator(this, attach_node(p, true, value)), true);
                     } else { p = p->left_son; }
-                } else if (cmp(p->data.first, value.first)) {
+                } else if (Multi || cmp(key_of(p->data), key_of(value))) {//Multi时相同的key插在已有的之后
                     if (have_null_right_son(p)) {
-                        p_insert = p->right_son = new node(nullptr, nullptr, p,
-                                                           value, red, p, p->next);
-                        ++siz;
-                        adjust_insert_link(p_insert);//双链表中插入节点
-                        break;
+                        return pair<iterator, bool>(iterator(this, attach_node(p, false, value)), true);
                     } else { p = p->right_son; }
                 } else { return pair<iterator, bool>(iterator(this, p), false); }
             }
-            //开始向上调整
-            if (p->colour == black) {
-                return pair<iterator, bool>(iterator(this, p_insert), true);
+        }
+
+        //带提示的插入。若value恰应插在hint与其前驱（或后继）之间，则直接挂上新节点，省去从根开始的查找；
+        //hint为end()时，检查value是否大于当前最大元素。提示不准确时退化为普通的insert
+        //Multi时value须排在与之相同的key之后，以保持插入顺序：前驱（或最大元素）可以与之相同，
+        //hint的key与之相同时退化为普通的insert
+        //返回指向新元素（或阻止插入的已有元素）的迭代器
+        iterator insert(iterator hint, const value_type &value) {
+            if (hint.get_map_point() != this) { throw invalid_iterator(); }
+            node *p = hint.get_iter_point();
+            if (root == nullptr) { return insert(value).first; }
+            if (p == nullptr) {
+                if (Multi ? !cmp(key_of(value), key_of(tail->data))
+                          : cmp(key_of(tail->data), key_of(value))) {//最大元素的右儿子必为空
+                    return iterator(this, attach_node(tail, false, value));
+                }
+            } else if (cmp(key_of(value), key_of(p->data))) {
+                node *p_pre = pre_of(p);
+                if (p_pre == nullptr || (Multi ? !cmp(key_of(value), key_of(p_pre->data))
+                                               : cmp(key_of(p_pre->data), key_of(value)))) {
+                    //p有左子树时，其前驱为左子树中的最大节点，右儿子必为空
+                    if (have_null_left_son(p)) { return iterator(this, attach_node(p, true, value)); }
+                    else { return iterator(this, attach_node(p_pre, false, value)); }
+                }
+            } else if (cmp(key_of(p->data), key_of(value))) {
+                node *p_next = next_of(p);
+                if (p_next == nullptr || cmp(key_of(value), key_of(p_next->data))) {
+                    //p有右子树时，其后继为右子树中的最小节点，左儿子必为空
+                    if (have_null_right_son(p)) { return iterator(this, attach_node(p, false, value)); }
+                    else { return iterator(this, attach_node(p_next, true, value)); }
+                }
+            } else if (!Multi) { return hint; }
+            return insert(value).first;
+        }
+
+        //以args原地构造value_type，再按hint插入
+        template<class... Args>
+        iterator emplace_hint(iterator hint, Args &&... args) {
+            return insert(hint, value_type(std::forward<Args>(args)...));
+        }
+
+        //将value作为p的左/右儿子挂上（对应儿子须为空），维护双链表并向上调整，返回新节点
+        node *attach_node(node *p, bool to_left, const value_type &value) {
+            node *p_insert = new node(nullptr, nullptr, p, value, red);
+            if (to_left) { p->left_son = p_insert; }
+            else { p->right_son = p_insert; }
+            ++siz;
+            adjust_insert_link(p_insert);//双链表中插入节点
+            pull_path(p_insert);//先更新到根的路径上的附加信息，之后的旋转各自维护
+            fix_insert(p);
+            return p_insert;
+        }
+
+        //p为新挂上的红节点的父节点，自p向上消除连续的红节点，返回树的黑高是否增加
+        bool fix_insert(node *p) {
+            if (colour_of(p) == black) { return false; }
+            while (true) {
+                if (colour_of(father_of(p)) == red) { p = father_of(p); }//向上一层
+                node *f = father_of(p);
+                bool grow = (f == root && have_red_left_son(f) && have_red_right_son(f));//根的两个儿子将被染黑
+                if (adjust_insert(p)) { return grow; }
+                p = father_of(p);
+            }
+        }
+
+        //以p为根的子树的黑高（含p，不含空节点）
+        inline static int black_height_of(node *p) {
+            int h = 0;
+            for (; p != nullptr; p = p->left_son) { h += (colour_of(p) == black); }
+            return h;
+        }
+
+        //将子树a、节点k、子树b合并为一棵红黑树并存于root，a中的key均小于k的，b中的均大于k的
+        //ha、hb为a、b的黑高，返回合并后的黑高
+        //两棵树的根先染黑，再沿较高一棵的右（左）边缘下降到黑高与另一棵相同的黑节点c，
+        //以红色的k代替c、并以c与另一棵树为k的两个儿子，最后按插入的方式向上调整。O(|ha - hb| + 1)
+        int join_trees(node *a, int ha, node *k, node *b, int hb) {
+            if (a != nullptr) {
+                set_father(a, nullptr);
+                if (colour_of(a) == red) {
+                    set_colour(a, black);
+                    ++ha;
+                }
+            }
+            if (b != nullptr) {
+                set_father(b, nullptr);
+                if (colour_of(b) == red) {
+                    set_colour(b, black);
+                    ++hb;
+                }
+            }
+            if (ha == hb) {
+                k->left_son = a;
+                k->right_son = b;
+                if (a != nullptr) { set_father(a, k); }
+                if (b != nullptr) { set_father(b, k); }
+                set_father(k, nullptr);
+                set_colour(k, black);
+                pull(k);
+                root = k;
+                return ha + 1;
+            }
+            node *f = nullptr, *c;
+            if (ha > hb) {
+                c = a;
+                int h = ha;//h为c的黑高
+                while (h > hb || (c != nullptr && colour_of(c) == red)) {
+                    if (colour_of(c) == black) { --h; }
+                    f = c;
+                    c = c->right_son;
+                }
+                k->left_son = c;
+                k->right_son = b;
+                f->right_son = k;
+                root = a;
+            } else {
+                c = b;
+                int h = hb;
+                while (h > ha || (c != nullptr && colour_of(c) == red)) {
+                    if (colour_of(c) == black) { --h; }
+                    f = c;
+                    c = c->left_son;
+                }
+                k->left_son = a;
+                k->right_son = c;
+                f->left_son = k;
+                root = b;
+            }
+            set_father(k, f);
+            set_colour(k, red);
+            if (k->left_son != nullptr) { set_father(k->left_son, k); }
+            if (k->right_son != nullptr) { set_father(k->right_son, k); }
+            pull_path(k);
+            return (ha > hb ? ha : hb) + (fix_insert(f) ? 1 : 0);
+        }
+
+        //将整棵树在节点x处切分：中序在x之前的节点组成树left，x及其后的节点组成树right，不维护双链表，O(log n)
+        //x的左子树归入left，x与其右子树合并为right；再沿父指针自下而上，路径上的每个节点连同其不在路径上的
+        //子树，合并进两棵树之一。两棵树均由下而上逐渐增高，合并的代价之和为O(log n)
+        //按位置而非key切分，Multi时相同的key也能分开
+        void split_tree_at(node *x, node *&left, int &left_bh, node *&right, int &right_bh) {
+            int h = black_height_of(x);//合并会改变x的颜色，先记下x的黑高
+            int hs = h - (colour_of(x) == black);//x的儿子的黑高
+            node *f = father_of(x), *p = x;
+            left = x->left_son;
+            left_bh = hs;
+            right_bh = join_trees(nullptr, 0, x, x->right_son, hs);
+            right = root;
+            while (f != nullptr) {//h为p的黑高
+                node *g = father_of(f);
+                int hf = h + (colour_of(f) == black);
+                if (f->right_son == p) {//f及其左子树均在p之前，且在left中的节点之前
+                    left_bh = join_trees(f->left_son, h, f, left, left_bh);
+                    left = root;
+                } else {
+                    right_bh = join_trees(right, right_bh, f, f->right_son, h);
+                    right = root;
+                }
+                h = hf;
+                p = f;
+                f = g;
             }
-            while (!flag) {
-                if (p->father->colour == red) { p = p->father; }//向上一层
-                flag = adjust_insert(p);
-                p = p->father;
+            if (left != nullptr) {//left可能从未参与合并，其根仍指向原来的父节点
+                set_father(left, nullptr);
+                set_colour(left, black);
             }
-            return pair<iterator, bool>(iterator(this, p_insert), true);
+            root = nullptr;
         }
 
         bool adjust_insert(node *p) {
@@ -552,32 +1419,33 @@ namespace sjtu {
             //插入节点总置为红色，调整至无连续红色返回true，否则返回false
             //连续红色发生在p和p的子节点之间
             //若p->father调整为红色，继续向上调整，返回false；反之，返回true
-            if (p->father->colour == black && have_red_left_son(p->father) &&
-                have_red_right_son(p->father)) {
-                p->father->left_son->colour = p->father->right_son->colour = black;
-                if (p->father == root) { return true; }//调整到根，结束
+            if (colour_of(father_of(p)) == black && have_red_left_son(father_of(p)) &&
+                have_red_right_son(father_of(p))) {
+                set_colour(father_of(p)->left_son, black);
+                set_colour(father_of(p)->right_son, black);
+                if (father_of(p) == root) { return true; }//调整到根，结束
                 else {
-                    p->father->colour = red;
+                    set_colour(father_of(p), red);
                     return false;//继续向上调整
                 }
             }
             if (is_left_son_of_father(p)) {
                 if (have_red_right_son(p)) {
                     rotate_RR(p);
-                    p = p->father;
+                    p = father_of(p);
                 }//需双旋，先旋转子树
-                rotate_LL(p->father);//再旋
-                p->right_son->colour = red;
-                p->colour = black;
+                rotate_LL(father_of(p));//再旋
+                set_colour(p->right_son, red);
+                set_colour(p, black);
                 return true;
             } else {
                 if (have_red_left_son(p)) {
                     rotate_LL(p);
-                    p = p->father;
+                    p = father_of(p);
                 }//需双旋，先旋转子树
-                rotate_RR(p->father);//再旋
-                p->left_son->colour = red;
-                p->colour = black;
+                rotate_RR(father_of(p));//再旋
+                set_colour(p->left_son, red);
+                set_colour(p, black);
                 return true;
             }
         }
@@ -588,76 +1456,172 @@ namespace sjtu {
             if (pos.get_map_point() != this || pos.get_iter_point() == nullptr) {
                 throw invalid_iterator();
             }
-            if (siz == 1) {
-                delete root;
+            node *p = pos.get_iter_point();
+            unlink_node(p);
+            --siz;
+            delete p;
+        }
+
+        static const size_t bulk_erase_threshold = 64;//区间内的元素多于此值时，改用切分与合并删除
+
+        //删除[first, last)中的元素，返回last，first不可在last之后
+        //区间较短时逐个删除；否则用两次切分取出整段直接释放，再join剩余的两部分，O(log n + k)，
+        //不做逐个节点的调整。切分不数两边的元素个数，整段的个数在检查区间时顺便数出
+        iterator erase(iterator first, iterator last) {
+            if (first.get_map_point() != this || last.get_map_point() != this) {
+                throw invalid_iterator();
+            }
+            node *p = first.get_iter_point(), *end_node = last.get_iter_point();
+            size_t steps = 0;
+            for (node *q = p; q != end_node; q = next_of(q), ++steps) {
+                if (q == nullptr) { throw invalid_iterator(); }//first在last之后
+            }
+            if (steps <= bulk_erase_threshold) {
+                while (p != end_node) {
+                    node *q = next_of(p);
+                    erase(iterator(this, p));
+                    p = q;
+                }
+                return last;
+            }
+            size_t rest = siz - steps;
+            map right(detach_from(end_node));
+            map middle(detach_from(p));
+            middle.siz = steps;
+            siz = 0;//join只需两边之和
+            right.siz = rest;
+            join(right);
+            return iterator(this, end_node);
+        }
+
+        //删除key对应的元素（Multi时为所有key相同的元素），返回删除的个数
+        size_t erase(const Key &key) {
+            node *p = find_in(root, key);
+            if (p == nullptr) { return 0; }
+            if (!Multi) {
+                erase(iterator(this, p));
+                return 1;
+            }
+            node *q = p;
+            size_t n = 0;
+            for (; q != nullptr && !cmp(key, key_of(q->data)); q = next_of(q)) { ++n; }
+            erase(iterator(this, p), iterator(this, q));
+            return n;
+        }
+
+        //删除所有使pred(value)为真的元素，返回删除的个数
+        //按顺序遍历一次，将保留的节点串起、删除的节点直接释放，最后用保留的节点O(n)重新建树，
+        //不做逐个节点的调整。保留的元素不移动，指向它们的迭代器仍有效
+        //pred抛出异常时，其余元素均保留，重新建树后再抛出
+        template<class Predicate>
+        size_t erase_if(Predicate pred) {
+            node *kept = nullptr, *erased = nullptr, *next_p;
+            size_t kept_count = 0, erased_count = 0;
+            std::exception_ptr error = nullptr;
+            //遍历中只改写已访问节点的左儿子指针，求后继时不会再用到，因此可以边遍历边串起
+            for (node *p = head; p != nullptr; p = next_p) {
+                next_p = next_of(p);
+                bool to_erase = false;
+                if (error == nullptr) {
+                    try {
+                        to_erase = pred(p->data);
+                    } catch (...) { error = std::current_exception(); }
+                }
+                if (to_erase) {
+                    p->left_son = erased;
+                    erased = p;
+                    ++erased_count;
+                } else {
+                    p->left_son = kept;//按逆序串起
+                    kept = p;
+                    ++kept_count;
+                }
+            }
+            while (erased != nullptr) {//紧凑节点的后继沿树求得，须遍历完才能释放
+                node *p = erased;
+                erased = erased->left_son;
+                delete p;
+            }
+            node *vine = nullptr;
+            while (kept != nullptr) {//倒序取出，以右儿子指针串成有序链
+                node *p = kept;
+                kept = kept->left_son;
+                p->right_son = vine;
+                vine = p;
+            }
+            build_from_vine(vine, kept_count);
+            if (error != nullptr) { std::rethrow_exception(error); }
+            return erased_count;
+        }
+
+        //将节点p从树与双链表中摘下并恢复平衡，不释放p，也不修改siz
+        void unlink_node(node *p) {
+            if (p == root && have_null_left_son(p) && have_null_right_son(p)) {
                 head = tail = root = nullptr;
-                --siz;
                 return;
             }
-            --siz;
-            node *p = pos.get_iter_point();
             if (!have_null_left_son(p) && !have_null_right_son(p)) {//两儿子情况，转为一个儿子或叶节点情况
                 //寻找替身，且尽量寻找红色替身以避免旋转，若前后替身均为黑色，则取后替身
-                if (p->pre->colour == red) {
-                    swap_node(p, p->pre);
+                node *p_pre = pre_of(p), *p_next = next_of(p);
+                if (colour_of(p_pre) == red) {
+                    swap_node(p, p_pre);
                 } else {
-                    swap_node(p, p->next);
+                    swap_node(p, p_next);
                 }
             }
             adjust_delete_link(p);//维护双链表
             if (have_red_left_son(p)) {//一个儿子情况，红黑树性质保证该节点只可能为黑、且只有一个红叶儿子
-                //将p的儿子染为黑色并挂在p父亲上，同时删除p
+                //将p的儿子染为黑色并挂在p父亲上
                 if (p == root) {
                     root = p->left_son;
-                    root->colour = black;
-                    root->father = nullptr;
+                    set_colour(root, black);
+                    set_father(root, nullptr);
                 } else if (is_left_son_of_father(p)) {
-                    p->father->left_son = p->left_son;
-                    p->left_son->father = p->father;
-                    p->left_son->colour = black;
+                    father_of(p)->left_son = p->left_son;
+                    set_father(p->left_son, father_of(p));
+                    set_colour(p->left_son, black);
                 } else {
-                    p->father->right_son = p->left_son;
-                    p->left_son->father = p->father;
-                    p->left_son->colour = black;
+                    father_of(p)->right_son = p->left_son;
+                    set_father(p->left_son, father_of(p));
+                    set_colour(p->left_son, black);
                 }
-                delete p;
+                pull_path(father_of(p));
                 return;//无需继续调整，结束
             } else if (have_red_right_son(p)) {
-                //将p的儿子染为黑色并挂在p父亲上，同时删除p
+                //将p的儿子染为黑色并挂在p父亲上
                 if (p == root) {
                     root = p->right_son;
-                    root->colour = black;
-                    root->father = nullptr;
+                    set_colour(root, black);
+                    set_father(root, nullptr);
                 } else if (is_left_son_of_father(p)) {
-                    p->father->left_son = p->right_son;
-                    p->right_son->father = p->father;
-                    p->right_son->colour = black;
+                    father_of(p)->left_son = p->right_son;
+                    set_father(p->right_son, father_of(p));
+                    set_colour(p->right_son, black);
                 } else {
-                    p->father->right_son = p->right_son;
-                    p->right_son->father = p->father;
-                    p->right_son->colour = black;
+                    father_of(p)->right_son = p->right_son;
+                    set_father(p->right_son, father_of(p));
+                    set_colour(p->right_son, black);
                 }
-                delete p;
+                pull_path(father_of(p));
                 return;//无需继续调整，结束
             } else {//为叶节点情况
-                if (p->colour == red) {
+                if (colour_of(p) == red) {
                     if (is_left_son_of_father(p)) {
-                        p->father->left_son = nullptr;
-                    } else { p->father->right_son = nullptr; }
-                    delete p;
-                    return;//直接删除，结束
+                        father_of(p)->left_son = nullptr;
+                    } else { father_of(p)->right_son = nullptr; }
+                    pull_path(father_of(p));
+                    return;//摘下即可，结束
                 } else {
-                    node *del = p;
                     bool flag = false, dir;//dir为真，表示删除发生的子树为其父节点的左子树
                     dir = is_left_son_of_father(p);
-                    if (dir) { p->father->left_son = nullptr; }
-                    else { p->father->right_son = nullptr; }
-                    p = p->father;
-                    delete del;
+                    if (dir) { father_of(p)->left_son = nullptr; }
+                    else { father_of(p)->right_son = nullptr; }
+                    p = father_of(p);
+                    pull_path(p);//先更新到根的路径上的附加信息，之后的旋转各自维护
                     while (!flag) {
                         flag = adjust_erase(p, dir);
                         dir = is_left_son_of_father(p);
-                        p = p->father;
+                        p = father_of(p);
                         if (p == nullptr) { break; }
                     }
                 }
@@ -671,76 +1635,76 @@ namespace sjtu {
             //dir为true，表失衡子树为p的左子树；反之，为右子树
             //返回false，表示p为根的子树比其兄弟树的黑路径数仍少1，需继续向上调整；反之，结束调整
             //发生旋转（即p不再为根）后，总是可终止；而需继续向上调整时，p仍保持为子树根节点
-            if (p->colour == red) {
+            if (colour_of(p) == red) {
                 if (dir) {
                     if (have_red_right_son(p->right_son)) {
                         rotate_RR(p);//需旋转
-                        p->colour = black;
-                        p->father->colour = red;
-                        p->father->right_son->colour = black;
+                        set_colour(p, black);
+                        set_colour(father_of(p), red);
+                        set_colour(father_of(p)->right_son, black);
                     } else if (have_red_left_son(p->right_son)) {
                         rotate_LL(p->right_son);//双旋转
                         rotate_RR(p);
-                        p->father->colour = black;
-                        p->father->right_son->colour = red;
+                        set_colour(father_of(p), black);
+                        set_colour(father_of(p)->right_son, red);
                     } else {
-                        p->colour = black;
-                        p->right_son->colour = red;
+                        set_colour(p, black);
+                        set_colour(p->right_son, red);
                     }
                 } else {
                     if (have_red_left_son(p->left_son)) {
                         rotate_LL(p);//需旋转
-                        p->colour = black;
-                        p->father->colour = red;
-                        p->father->left_son->colour = black;
+                        set_colour(p, black);
+                        set_colour(father_of(p), red);
+                        set_colour(father_of(p)->left_son, black);
                     } else if (have_red_right_son(p->left_son)) {
                         rotate_RR(p->left_son);//双旋转
                         rotate_LL(p);
-                        p->father->colour = black;
-                        p->father->left_son->colour = red;
+                        set_colour(father_of(p), black);
+                        set_colour(father_of(p)->left_son, red);
                     } else {
-                        p->colour = black;
-                        p->left_son->colour = red;
+                        set_colour(p, black);
+                        set_colour(p->left_son, red);
                     }
                 }
                 return true;//结束调整
             } else {
                 if (dir) {
-                    if (p->right_son->colour == red) {//需调整的树的兄节点为红
+                    if (colour_of(p->right_son) == red) {//需调整的树的兄节点为红
                         rotate_RR(p);
-                        p->colour = red;
-                        p->father->colour = black;
+                        set_colour(p, red);
+                        set_colour(father_of(p), black);
                         return adjust_erase(p, true);//此时，转换为p为红的情况
                     } else {//兄弟节点为黑
                         if (have_red_right_son(p->right_son)) {
                             rotate_RR(p);
-                            p->father->right_son->colour = black;
+                            set_colour(father_of(p)->right_son, black);
                         } else if (have_red_left_son(p->right_son)) {
                             rotate_LL(p->right_son);
                             rotate_RR(p);
-                            p->father->colour = black;
+                            set_colour(father_of(p), black);
                         } else {
-                            p->right_son->colour = red;
+                            set_colour(p->right_son, red);
                             return false;//仍未平衡，继续向上调整
                         }
                     }
                     return true;
                 } else {
-                    if (p->left_son->colour == red) {//需调整的树的兄节点为红
+                    if (colour_of(p->left_son) == red) {//需调整的树的兄节点为红
                         rotate_LL(p);
-                        p->colour = red;
-                        p->father->colour = black;
+                        set_colour(p, red);
+                        set_colour(father_of(p), black);
                         return adjust_erase(p, false);//此时，转换为p为红的情况
                     } else {//兄弟节点为黑
                         if (have_red_left_son(p->left_son)) {
                             rotate_LL(p);
-                            p->father->left_son->colour = black;
+                            set_colour(father_of(p)->left_son, black);
                         } else if (have_red_right_son(p->left_son)) {
                             rotate_RR(p->left_son);
                             rotate_LL(p);
-                            p->father->colour = black;
+                            set_colour(father_of(p), black);
                         } else {
-                            p->left_son->colour = red;
+                            set_colour(p->left_son, red);
                             return false;//仍未平衡，继续向上调整
                         }
                     }
@@ -753,51 +1717,100 @@ namespace sjtu {
 //  that compares equivalent to the specified argument,
 //  which is either 1 or 0
 //     since this container does not allow duplicates.
+//  (if Multi, all equivalent elements are counted, in O(log n + count))
 // The default method of check the equivalence is !(a < b || b > a)
         size_t count(const Key &key) const {
-            if (root == nullptr) { return 0; }
-            node *p = root;
-            while (true) {
-                if (p == nullptr) { return 0; }
-                if (cmp(key, p->data.first)) {
-                    p = p->left_son;
-                } else if (cmp(p->data.first, key)) {
-                    p = p->right_son;
-                } else { return 1; }
-            }
+            node *p = find_in(root, key);
+            if (!Multi) { return p != nullptr; }
+            size_t n = 0;
+            for (; p != nullptr && !cmp(key, key_of(p->data)); p = next_of(p)) { ++n; }
+            return n;
         }
 
         //Finds an element with key equivalent to key.
         //key value of the element to search for.
         //Iterator to an element with key equivalent to key.
         //  If no such element is found, past-the-end (see end()) iterator is returned.
-        iterator find(const Key &key) {
+        //  (if Multi, the first of the equivalent elements)
+        iterator find(const Key &key) { return iterator(this, find_in(root, key)); }
+
+        const_iterator find(const Key &key) const { return const_iterator(this, find_in(root, key)); }
+
+        //第一个key不小于key的元素
+        iterator lower_bound(const Key &key) { return iterator(this, lower_bound_of(key)); }
+
+        const_iterator lower_bound(const Key &key) const { return const_iterator(this, lower_bound_of(key)); }
+
+        //第一个key大于key的元素
+        iterator upper_bound(const Key &key) { return iterator(this, upper_bound_of(key)); }
+
+        const_iterator upper_bound(const Key &key) const { return const_iterator(this, upper_bound_of(key)); }
+
+        //以finger为起点查找key，finger通常为上一次查找的结果，finger为end()时从最大元素出发
+        //key与finger在中序中相距d时，通常为O(log d)
+        iterator find(iterator finger, const Key &key) {
+            if (finger.get_map_point() != this) { throw invalid_iterator(); }
             if (root == nullptr) { return iterator(this, nullptr); }
-            node *p = root;
-            while (true) {
-                if (p == nullptr) { return iterator(this, nullptr); }
-                if (cmp(key, p->data.first)) {
-                    p = p->left_son;
-                } else if (cmp(p->data.first, key)) {
-                    p = p->right_son;
-                } else { return iterator(this, p); }
-            }
+            node *p = finger.get_iter_point();
+            return iterator(this, first_equal(find_from(p != nullptr ? p : tail, key)));
         }
 
-        const_iterator find(const Key &key) const {
+        const_iterator find(const_iterator finger, const Key &key) const {
+            if (finger.get_map_point() != this) { throw invalid_iterator(); }
             if (root == nullptr) { return const_iterator(this, nullptr); }
-            node *p = root;
-            while (true) {
-                if (p == nullptr) { return const_iterator(this, nullptr); }
-                if (cmp(key, p->data.first)) {
-                    p = p->left_son;
-                } else if (cmp(p->data.first, key)) {
-                    p = p->right_son;
-                } else { return const_iterator(this, p); }
+            node *p = finger.get_iter_point();
+            return const_iterator(this, first_equal(find_from(p != nullptr ? p : tail, key)));
+        }
+
+        //批量查找keys[0..n)，out[i]为keys[i]对应的迭代器，不存在时为end()
+        //各查找分组交错进行并预取节点，map远大于缓存时吞吐量高于逐个find
+        void find_batch(const Key *keys, size_t n, iterator *out) {
+            node *found[batch_group];
+            for (size_t base = 0; base < n; base += batch_group) {
+                size_t m = (n - base < batch_group ? n - base : batch_group);
+                find_group(keys + base, m, found);
+                for (size_t i = 0; i < m; ++i) { out[base + i] = iterator(this, first_equal(found[i])); }
+            }
+        }
+
+        void find_batch(const Key *keys, size_t n, const_iterator *out) const {
+            node *found[batch_group];
+            for (size_t base = 0; base < n; base += batch_group) {
+                size_t m = (n - base < batch_group ? n - base : batch_group);
+                find_group(keys + base, m, found);
+                for (size_t i = 0; i < m; ++i) { out[base + i] = const_iterator(this, first_equal(found[i])); }
             }
         }
     };
 
+    template<class Key, class T, class Compare = std::less<Key> >
+    using multimap = map<Key, T, Compare, map_no_augment, true>;
+
+    //a与b的并、交、差，结果按key有序，O(|a| + |b|)
+    template<class Key, class T, class Compare, class Augment, bool Multi>
+    map<Key, T, Compare, Augment, Multi> set_union(const map<Key, T, Compare, Augment, Multi> &a,
+                                                   const map<Key, T, Compare, Augment, Multi> &b) {
+        map<Key, T, Compare, Augment, Multi> result;
+        result.merge_from(a, b, true, true, true);
+        return result;
+    }
+
+    template<class Key, class T, class Compare, class Augment, bool Multi>
+    map<Key, T, Compare, Augment, Multi> set_intersection(const map<Key, T, Compare, Augment, Multi> &a,
+                                                          const map<Key, T, Compare, Augment, Multi> &b) {
+        map<Key, T, Compare, Augment, Multi> result;
+        result.merge_from(a, b, false, false, true);
+        return result;
+    }
+
+    template<class Key, class T, class Compare, class Augment, bool Multi>
+    map<Key, T, Compare, Augment, Multi> set_difference(const map<Key, T, Compare, Augment, Multi> &a,
+                                                        const map<Key, T, Compare, Augment, Multi> &b) {
+        map<Key, T, Compare, Augment, Multi> result;
+        result.merge_from(a, b, true, false, false);
+        return result;
+    }
+
     struct my_true_type {
     };//标识真
 
@@ -0,0 +1,303 @@
+/**
+ * implement a read-only file image of sjtu::map
+ */
+#ifndef SJTU_MAP_IMAGE_HPP
+#define SJTU_MAP_IMAGE_HPP
+
+#include <functional>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "map.hpp"
+
+namespace sjtu {
+
+    /**
+     * a sorted, read-only image of a map mapped from a file.
+     * the file is written by dump(): a header, all keys in ascending order, all values in the same
+     * order, and a sparse index holding every index_stride-th key. keys and values are stored
+     * separately so that a lookup only touches the (small) index and one block of keys.
+     * lookups are served directly from the mapping; to_map() rebuilds a sjtu::map in O(n).
+     * Key and T must be trivially copyable, and the file is only readable on a machine with the
+     * same byte order and type layout.
+     */
+    template<
+            class Key,
+            class T,
+            class Compare = std::less<Key>
+    >
+    class map_image {
+        static_assert(std::is_trivially_copyable<Key>::value, "map_image requires a trivially copyable Key");
+        static_assert(std::is_trivially_copyable<T>::value, "map_image requires a trivially copyable T");
+
+    public:
+
+        typedef pair<const Key, T> value_type;
+
+        static const size_t index_stride = 64;
+
+    private:
+
+        struct header {
+            char magic[8];
+            uint64_t version;
+            uint64_t count;
+            uint64_t key_size;
+            uint64_t value_size;
+            uint64_t stride;
+            uint64_t key_offset;//各数组在文件中的偏移
+            uint64_t value_offset;
+            uint64_t index_offset;
+            uint64_t file_size;
+        };
+
+        static const uint64_t image_version = 1;
+
+        inline static const char *image_magic() { return "SJTUMAP"; }
+
+        inline static uint64_t align_up(uint64_t x) { return (x + 63) / 64 * 64; }//各数组按缓存行对齐
+
+        //按count计算各数组的偏移
+        static void layout(header &h, uint64_t count) {
+            std::memset(&h, 0, sizeof(h));
+            std::memcpy(h.magic, image_magic(), 8);
+            h.version = image_version;
+            h.count = count;
+            h.key_size = sizeof(Key);
+            h.value_size = sizeof(T);
+            h.stride = index_stride;
+            h.key_offset = align_up(sizeof(header));
+            h.value_offset = align_up(h.key_offset + count * sizeof(Key));
+            h.index_offset = align_up(h.value_offset + count * sizeof(T));
+            h.file_size = h.index_offset + (count + index_stride - 1) / index_stride * sizeof(Key);
+        }
+
+        //以off_t定位，long只有32位时文件也可超过2GiB
+        static bool seek_to(std::FILE *file, uint64_t offset) { return fseeko(file, off_t(offset), SEEK_SET) == 0; }
+
+        static bool write_at(std::FILE *file, uint64_t offset, const void *data, size_t len) {
+            return seek_to(file, offset) && std::fwrite(data, 1, len, file) == len;
+        }
+
+        void *base;
+        size_t mapped_size;
+        const header *head;
+        const Key *keys;
+        const T *values;
+        const Key *index;
+        size_t index_count;
+        Compare cmp;
+
+        void unmap() {
+            if (base != nullptr) { munmap(base, mapped_size); }
+            base = nullptr;
+            head = nullptr;
+            keys = index = nullptr;
+            values = nullptr;
+            mapped_size = index_count = 0;
+        }
+
+    public:
+
+        /**
+         * const_iterator walks the image in key order.
+         * dereferencing yields a value_type by value, since the image stores keys and values apart.
+         */
+        class const_iterator {
+            friend class map_image;
+
+        private:
+            const map_image *image;
+            size_t pos;
+
+            const_iterator(const map_image *image_, size_t pos_) : image(image_), pos(pos_) {}
+
+        public:
+            const_iterator() : image(nullptr), pos(0) {}
+
+            const_iterator operator++(int) {
+                const_iterator tmp = *this;
+                ++pos;
+                return tmp;
+            }
+
+            const_iterator &operator++() {
+                ++pos;
+                return *this;
+            }
+
+            value_type operator*() const { return value_type(image->keys[pos], image->values[pos]); }
+
+            bool operator==(const const_iterator &rhs) const { return image == rhs.image && pos == rhs.pos; }
+
+            bool operator!=(const const_iterator &rhs) const { return !(*this == rhs); }
+        };
+
+        map_image() : base(nullptr), mapped_size(0), head(nullptr), keys(nullptr), values(nullptr),
+                      index(nullptr), index_count(0) {}
+
+        explicit map_image(const char *path) : map_image() { open(path); }
+
+        map_image(const map_image &other) = delete;
+
+        map_image &operator=(const map_image &other) = delete;
+
+        ~map_image() { unmap(); }
+
+        //将m按key顺序写入文件path，文件已存在时覆盖。写入失败时抛出runtime_error，path不变
+        //先写到同一目录下的临时文件并同步到磁盘，再以rename替换path：已映射旧文件的map_image仍读旧的内容，
+        //而直接截断原文件会使它们访问映射时收到SIGBUS
+        static void dump(const map<Key, T, Compare> &m, const char *path) {
+            header h;
+            layout(h, m.size());
+            std::string tmp_path = std::string(path) + ".XXXXXX";
+            int fd = mkstemp(&tmp_path[0]);
+            if (fd < 0) { throw runtime_error(); }
+            std::FILE *file = nullptr;
+            if (fchmod(fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH) != 0 || (file = fdopen(fd, "wb")) == nullptr) {//mkstemp的文件只有所有者可读
+                ::close(fd);
+                unlink(tmp_path.c_str());
+                throw runtime_error();
+            }
+            std::setvbuf(file, nullptr, _IOFBF, 1 << 20);
+            bool ok = write_at(file, 0, &h, sizeof(h));
+            //依次顺序写入key数组、value数组和稀疏索引，每个数组各遍历一次map
+            typedef typename map<Key, T, Compare>::const_iterator map_iterator;
+            ok = ok && seek_to(file, h.key_offset);
+            for (map_iterator it = m.cbegin(); ok && it != m.cend(); ++it) {
+                ok = std::fwrite(&it->first, sizeof(Key), 1, file) == 1;
+            }
+            ok = ok && seek_to(file, h.value_offset);
+            for (map_iterator it = m.cbegin(); ok && it != m.cend(); ++it) {
+                ok = std::fwrite(&it->second, sizeof(T), 1, file) == 1;
+            }
+            ok = ok && seek_to(file, h.index_offset);
+            size_t i = 0;
+            for (map_iterator it = m.cbegin(); ok && it != m.cend(); ++it, ++i) {
+                if (i % index_stride == 0) { ok = std::fwrite(&it->first, sizeof(Key), 1, file) == 1; }
+            }
+            //索引为空时末尾是对齐留下的空洞，补零使文件大小与header一致
+            ok = ok && fseeko(file, 0, SEEK_END) == 0;
+            for (off_t pos = ok ? ftello(file) : 0; ok && pos >= 0 && uint64_t(pos) < h.file_size; ++pos) {
+                ok = std::fputc(0, file) != EOF;
+            }
+            ok = ok && std::fflush(file) == 0 && fsync(fileno(file)) == 0;
+            ok = (std::fclose(file) == 0) && ok;
+            ok = ok && std::rename(tmp_path.c_str(), path) == 0;
+            if (!ok) {
+                unlink(tmp_path.c_str());
+                throw runtime_error();
+            }
+        }
+
+        //以只读方式映射文件path，替换当前映射。文件无法打开或格式不符时抛出runtime_error
+        void open(const char *path) {
+            unmap();
+            int fd = ::open(path, O_RDONLY);
+            if (fd < 0) { throw runtime_error(); }
+            struct stat st;
+            if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(header)) {
+                ::close(fd);
+                throw runtime_error();
+            }
+            void *p = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+            ::close(fd);//映射建立后即可关闭文件
+            if (p == MAP_FAILED) { throw runtime_error(); }
+            const header *h = static_cast<const header *>(p);
+            //先以文件大小约束count，使layout中count与元素大小的乘积不会溢出
+            uint64_t key_offset = align_up(sizeof(header)), file_size = uint64_t(st.st_size);
+            if (file_size < key_offset || h->count > (file_size - key_offset) / (sizeof(Key) + sizeof(T))) {
+                munmap(p, size_t(st.st_size));
+                throw runtime_error();
+            }
+            header expect;
+            layout(expect, h->count);
+            if (std::memcmp(h->magic, expect.magic, 8) != 0 || h->version != expect.version ||
+                h->key_size != expect.key_size || h->value_size != expect.value_size ||
+                h->stride != expect.stride || h->key_offset != expect.key_offset ||
+                h->value_offset != expect.value_offset || h->index_offset != expect.index_offset ||
+                h->file_size != expect.file_size ||
+                uint64_t(st.st_size) < expect.file_size) {
+                munmap(p, size_t(st.st_size));
+                throw runtime_error();
+            }
+            base = p;
+            mapped_size = size_t(st.st_size);
+            head = h;
+            const char *bytes = static_cast<const char *>(p);
+            keys = reinterpret_cast<const Key *>(bytes + h->key_offset);
+            values = reinterpret_cast<const T *>(bytes + h->value_offset);
+            index = reinterpret_cast<const Key *>(bytes + h->index_offset);
+            index_count = (h->count + index_stride - 1) / index_stride;
+            madvise(p, mapped_size, MADV_RANDOM);//查找只访问少数页，关闭预读
+        }
+
+        bool is_open() const { return base != nullptr; }
+
+        void close() { unmap(); }
+
+        size_t size() const { return head == nullptr ? 0 : size_t(head->count); }
+
+        bool empty() const { return size() == 0; }
+
+        //返回第i小的key和对应的值，不检查越界
+        const Key &key_at(size_t i) const { return keys[i]; }
+
+        const T &value_at(size_t i) const { return values[i]; }
+
+        //返回key在image中的位置，不存在时返回size()
+        //先在稀疏索引上二分确定所在的块，再在块内二分，大部分访问落在常驻缓存的索引上
+        size_t position_of(const Key &key) const {
+            size_t l = 0, r = index_count;//找到最后一个不大于key的索引项
+            while (l < r) {
+                size_t mid = (l + r) / 2;
+                if (cmp(key, index[mid])) { r = mid; }
+                else { l = mid + 1; }
+            }
+            if (l == 0) { return size(); }
+            size_t block_l = (l - 1) * index_stride, block_r = block_l + index_stride;
+            if (block_r > size()) { block_r = size(); }
+            while (block_l < block_r) {
+                size_t mid = (block_l + block_r) / 2;
+                if (cmp(keys[mid], key)) { block_l = mid + 1; }
+                else { block_r = mid; }
+            }
+            if (block_l < size() && !cmp(key, keys[block_l])) { return block_l; }
+            return size();
+        }
+
+        //返回key对应的值的指针，不存在时返回nullptr
+        const T *find(const Key &key) const {
+            size_t pos = position_of(key);
+            return pos == size() ? nullptr : values + pos;
+        }
+
+        size_t count(const Key &key) const { return position_of(key) == size() ? 0 : 1; }
+
+        const T &at(const Key &key) const {
+            size_t pos = position_of(key);
+            if (pos == size()) { throw index_out_of_bound(); }
+            return values[pos];
+        }
+
+        const_iterator cbegin() const { return const_iterator(this, 0); }
+
+        const_iterator cend() const { return const_iterator(this, size()); }
+
+        //按顺序读取整个image，O(n)重建为map，替换m原有的内容
+        void to_map(map<Key, T, Compare> &m) const {
+            if (base != nullptr) { madvise(base, mapped_size, MADV_SEQUENTIAL); }
+            m.assign_sorted(cbegin(), cend());
+            if (base != nullptr) { madvise(base, mapped_size, MADV_RANDOM); }
+        }
+    };
+}
+
+#endif
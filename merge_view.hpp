@@ -0,0 +1,247 @@
+/**
+ * implement a lazy k-way merge of sorted ranges
+ */
+#ifndef SJTU_MERGE_VIEW_HPP
+#define SJTU_MERGE_VIEW_HPP
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "exceptions.hpp"
+
+namespace sjtu {
+
+    /**
+     * merges several ranges [first, last), each sorted in ascending order under Compare, into
+     * one ascending sequence produced lazily (like std::merge, and unlike priority_queue, whose
+     * top is the greatest element). equal elements come out in the order of their sources,
+     * then in their order within a source, so the merge is stable.
+     * a loser tree keeps, in each internal node, the source that lost the match played there;
+     * after an element is taken, only the path from its source's leaf to the root is replayed,
+     * one comparison per level: about log2(k) comparisons per element for k sources, and no
+     * allocation once the tree is built.
+     * the view is single-pass: front and pop_front, or begin and end, consume the ranges.
+     * the source iterators need only be copyable, comparable with == and incrementable, but
+     * dereferencing them must yield an lvalue: every node of the tree keeps a pointer to the
+     * current element of its source, so a match does not go through the iterators.
+     */
+    template<class Iterator,
+            class Compare = std::less<typename std::decay<decltype(*std::declval<Iterator &>())>::type> >
+    class merge_view {
+    public:
+
+        typedef typename std::decay<decltype(*std::declval<Iterator &>())>::type value_type;
+        static_assert(std::is_lvalue_reference<decltype(*std::declval<Iterator &>())>::value,
+                      "merge_view needs iterators yielding lvalues");
+
+    private:
+
+        struct source {
+            Iterator cur;
+            Iterator last;
+
+            source(const Iterator &first_, const Iterator &last_) : cur(first_), last(last_) {}
+        };
+
+        struct entry {//一个来源及其当前的元素，读完时key为nullptr
+            const value_type *key;
+            size_t index;
+        };
+
+        source *sources;
+        size_t count;
+        size_t capacity;
+        mutable entry *tree;//tree[0]为胜者，tree[1]至tree[count - 1]为各场比赛的败者；叶子i位于count + i
+        mutable bool built;
+
+        entry entry_of(size_t i) const {
+            entry e;
+            e.key = (sources[i].cur == sources[i].last ? nullptr : &*sources[i].cur);
+            e.index = i;
+            return e;
+        }
+
+        //x是否排在y前面：读完的来源排在最后，元素相等时编号小的在前。只比较一次，
+        //比较的方向由编号决定，以下标选取两个操作数，不产生难以预测的分支
+        inline static bool before(const entry &x, const entry &y) {
+            if (y.key == nullptr) { return x.key != nullptr || x.index < y.index; }
+            if (x.key == nullptr) { return false; }
+            bool x_first = x.index < y.index;
+            const value_type *keys[2] = {x.key, y.key};
+            return Compare()(*keys[x_first], *keys[!x_first]) != x_first;
+        }
+
+        void build() const {
+            if (!built) { build_tree(); }
+        }
+
+        //自底向上决出每场比赛，O(k)
+        void build_tree() const {
+            if (tree == nullptr && count > 0) { tree = new entry[count]; }
+            if (count > 1) {
+                entry *win = new entry[count];//win[n]为以n为根的子树的胜者
+                try {
+                    for (size_t n = count - 1; n > 0; --n) {
+                        size_t l = 2 * n, r = 2 * n + 1;
+                        entry a = (l >= count ? entry_of(l - count) : win[l]);
+                        entry b = (r >= count ? entry_of(r - count) : win[r]);
+                        bool a_wins = before(a, b);
+                        win[n] = (a_wins ? a : b);
+                        tree[n] = (a_wins ? b : a);
+                    }
+                } catch (...) {
+                    delete[] win;
+                    throw;
+                }
+                tree[0] = win[1];
+                delete[] win;
+            } else if (count == 1) { tree[0] = entry_of(0); }
+            built = true;
+        }
+
+        //来源前进一个元素后，以其新的entry沿叶子到根的路径重赛。胜负难以预测，同样以下标选取
+        void replay(entry w) {
+            for (size_t n = (count + w.index) / 2; n > 0; n /= 2) {
+                entry players[2] = {tree[n], w};
+                bool swapped = before(players[0], players[1]);
+                tree[n] = players[swapped];
+                w = players[!swapped];
+            }
+            tree[0] = w;
+        }
+
+        void destroy() {
+            for (size_t i = 0; i < count; ++i) { sources[i].~source(); }
+            ::operator delete(sources);
+            delete[] tree;
+        }
+
+    public:
+
+        /**
+         * an input iterator over the merged sequence; incrementing it consumes the view.
+         * all iterators of a view at its end compare equal to end().
+         */
+        class iterator {
+            friend class merge_view;
+
+        private:
+            merge_view *view;
+
+            explicit iterator(merge_view *view_) : view(view_) {}
+
+            bool at_end() const { return view == nullptr || view->empty(); }
+
+        public:
+            iterator() : view(nullptr) {}
+
+            const value_type &operator*() const { return view->front(); }
+
+            const value_type *operator->() const { return &view->front(); }
+
+            iterator &operator++() {
+                view->pop_front();
+                return *this;
+            }
+
+            void operator++(int) { view->pop_front(); }
+
+            bool operator==(const iterator &rhs) const {
+                bool a = at_end(), b = rhs.at_end();
+                return a || b ? a == b : view == rhs.view;
+            }
+
+            bool operator!=(const iterator &rhs) const { return !(*this == rhs); }
+        };
+
+        merge_view() : sources(nullptr), count(0), capacity(0), tree(nullptr), built(false) {}
+
+        merge_view(const merge_view &other) : sources(nullptr), count(0), capacity(0), tree(nullptr), built(false) {
+            try {
+                for (size_t i = 0; i < other.count; ++i) { add(other.sources[i].cur, other.sources[i].last); }
+            } catch (...) {
+                destroy();
+                throw;
+            }
+        }
+
+        ~merge_view() { destroy(); }
+
+        merge_view &operator=(const merge_view &other) {
+            if (this == &other) { return *this; }
+            merge_view tmp(other);
+            std::swap(sources, tmp.sources);
+            std::swap(count, tmp.count);
+            std::swap(capacity, tmp.capacity);
+            std::swap(tree, tmp.tree);
+            std::swap(built, tmp.built);
+            return *this;
+        }
+
+        //加入有序的区间[first, last)，编号为之前加入的区间个数。加入后下次访问时重建整棵树
+        void add(const Iterator &first, const Iterator &last) {
+            if (count == capacity) {
+                size_t new_capacity = (capacity == 0 ? 8 : capacity * 2);
+                source *new_sources = static_cast<source *>(::operator new(new_capacity * sizeof(source)));
+                size_t i = 0;
+                try {
+                    for (; i < count; ++i) { new(new_sources + i) source(sources[i]); }
+                    new(new_sources + count) source(first, last);
+                } catch (...) {
+                    while (i > 0) { new_sources[--i].~source(); }
+                    ::operator delete(new_sources);
+                    throw;
+                }
+                for (i = 0; i < count; ++i) { sources[i].~source(); }
+                ::operator delete(sources);
+                sources = new_sources;
+                capacity = new_capacity;
+            } else { new(sources + count) source(first, last); }
+            ++count;
+            delete[] tree;
+            tree = nullptr;
+            built = false;
+        }
+
+        //区间的个数
+        size_t source_count() const { return count; }
+
+        bool empty() const {
+            build();
+            return count == 0 || tree[0].key == nullptr;
+        }
+
+        //剩余元素中最小的一个
+        const value_type &front() const {
+            if (empty()) { throw container_is_empty(); }
+            return *tree[0].key;
+        }
+
+        //front所在区间的编号
+        size_t front_source() const {
+            if (empty()) { throw container_is_empty(); }
+            return tree[0].index;
+        }
+
+        //比较抛出异常时元素已取出，下次访问时重建整棵树
+        void pop_front() {
+            if (empty()) { throw container_is_empty(); }
+            size_t w = tree[0].index;
+            ++sources[w].cur;
+            try {
+                replay(entry_of(w));
+            } catch (...) {
+                built = false;
+                throw;
+            }
+        }
+
+        iterator begin() { return iterator(this); }
+
+        iterator end() { return iterator(); }
+    };
+}
+
+#endif
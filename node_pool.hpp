@@ -0,0 +1,86 @@
+/**
+ * implement a free list recycling the nodes of a linked container
+ */
+#ifndef SJTU_NODE_POOL_HPP
+#define SJTU_NODE_POOL_HPP
+
+#include <cstddef>
+#include <new>
+
+namespace sjtu {
+
+    /**
+     * a per-container cache of raw memory blocks, each large enough for one Node.
+     * deallocate() keeps the block in an intrusive free list instead of returning it, and
+     * allocate() reuses such a block before asking operator new; a container whose size stays
+     * bounded therefore stops allocating once it has reached its largest size.
+     * the pool only hands out memory: constructing and destroying the Node is up to the caller.
+     * blocks come from operator new one by one, so a block may be deallocated into a different
+     * pool than the one it was allocated from (e.g. after two containers are merged).
+     */
+    template<class Node>
+    class node_pool {
+    private:
+
+        struct free_node {
+            free_node *next;
+        };
+
+        static_assert(sizeof(Node) >= sizeof(free_node), "a node must be able to hold a pointer");
+
+        free_node *free_list;
+        size_t free_count;
+
+    public:
+
+        node_pool() : free_list(nullptr), free_count(0) {}
+
+        //复制容器时不复制缓存的空闲块
+        node_pool(const node_pool &) : free_list(nullptr), free_count(0) {}
+
+        node_pool &operator=(const node_pool &) { return *this; }
+
+        ~node_pool() { release(); }
+
+        //返回一块可放下一个Node的未初始化内存
+        void *allocate() {
+            if (free_list == nullptr) { return ::operator new(sizeof(Node)); }
+            free_node *p = free_list;
+            free_list = p->next;
+            --free_count;
+            return p;
+        }
+
+        //回收p所指的内存，其上的Node须已析构
+        void deallocate(void *p) {
+            free_node *q = new(p) free_node;
+            q->next = free_list;
+            free_list = q;
+            ++free_count;
+        }
+
+        //空闲块的个数
+        size_t cached() const { return free_count; }
+
+        //将全部空闲块还给系统
+        void release() {
+            while (free_list != nullptr) {
+                free_node *p = free_list;
+                free_list = p->next;
+                ::operator delete(p);
+            }
+            free_count = 0;
+        }
+
+        void swap(node_pool &other) {
+            free_node *p = free_list;
+            free_list = other.free_list;
+            other.free_list = p;
+            size_t n = free_count;
+            free_count = other.free_count;
+            other.free_count = n;
+        }
+    };
+}
+
+#endif
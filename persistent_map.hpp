@@ -0,0 +1,432 @@
+/**
+ * implement a persistent (path-copying) map
+ */
+#ifndef SJTU_PERSISTENT_MAP_HPP
+#define SJTU_PERSISTENT_MAP_HPP
+
+#include <functional>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include "utility.hpp"
+#include "exceptions.hpp"
+
+namespace sjtu {
+
+    /**
+     * a map whose every version is immutable.
+     * each update copies only the O(log n) nodes on its search path and publishes the new version atomically,
+     * so readers holding a snapshot never block and never see a half-done update.
+     * nodes are shared between versions and reclaimed by reference counting.
+     */
+    template<
+            class Key,
+            class T,
+            class Compare = std::less<Key>
+    >
+    class persistent_map {
+    public:
+
+        typedef pair<const Key, T> value_type;
+
+        class snapshot;
+
+        class const_iterator;
+
+        enum colourT {
+            red, black
+        };
+
+    private:
+
+        struct node;
+
+        typedef std::shared_ptr<const node> node_ptr;
+
+        struct node {
+            colourT colour;
+            node_ptr left_son;
+            node_ptr right_son;
+            value_type data;
+
+            node(colourT colour_, const node_ptr &left_son_, const value_type &data_, const node_ptr &right_son_) :
+                    colour(colour_), left_son(left_son_), right_son(right_son_), data(data_) {}
+        };//节点一经发布便不再修改，修改均通过复制路径上的节点完成
+
+        struct version {
+            node_ptr root;
+            size_t siz;
+
+            version(const node_ptr &root_, size_t siz_) : root(root_), siz(siz_) {}
+        };
+
+        typedef std::shared_ptr<const version> version_ptr;
+
+        static const int max_depth = 128;//红黑树高度不超过2log(n+1)
+
+        version_ptr now;//当前版本，只通过std::atomic_load/std::atomic_store访问
+        std::mutex write_lock;//写者之间互斥，读者不加锁
+
+        inline static node_ptr make(colourT colour, const node_ptr &left_son, const value_type &data,
+                                    const node_ptr &right_son) {
+            return std::make_shared<node>(colour, left_son, data, right_son);
+        }
+
+        inline static bool is_red(const node_ptr &p) { return p != nullptr && p->colour == red; }
+
+        inline static bool is_black(const node_ptr &p) { return p != nullptr && p->colour == black; }
+
+        inline static node_ptr paint(const node_ptr &p, colourT colour) {
+            if (p == nullptr || p->colour == colour) { return p; }
+            return make(colour, p->left_son, p->data, p->right_son);
+        }
+
+        //左子树插入后（可能产生连续红节点）的平衡
+        static node_ptr balance_left(const node_ptr &l, const value_type &data, const node_ptr &r) {
+            if (is_red(l) && is_red(l->left_son)) {
+                return make(red, paint(l->left_son, black), l->data, make(black, l->right_son, data, r));
+            }
+            if (is_red(l) && is_red(l->right_son)) {
+                return make(red, make(black, l->left_son, l->data, l->right_son->left_son),
+                            l->right_son->data, make(black, l->right_son->right_son, data, r));
+            }
+            return make(black, l, data, r);
+        }
+
+        //右子树插入后（可能产生连续红节点）的平衡
+        static node_ptr balance_right(const node_ptr &l, const value_type &data, const node_ptr &r) {
+            if (is_red(r) && is_red(r->right_son)) {
+                return make(red, make(black, l, data, r->left_son), r->data, paint(r->right_son, black));
+            }
+            if (is_red(r) && is_red(r->left_son)) {
+                return make(red, make(black, l, data, r->left_son->left_son),
+                            r->left_son->data, make(black, r->left_son->right_son, r->data, r->right_son));
+            }
+            return make(black, l, data, r);
+        }
+
+        //左子树黑路径长度减少1后的平衡
+        static node_ptr repair_left(const node_ptr &l, const value_type &data, const node_ptr &r) {
+            if (is_red(l)) { return make(red, paint(l, black), data, r); }
+            if (is_black(r)) { return balance_right(l, data, paint(r, red)); }
+            if (is_red(r) && is_black(r->left_son)) {
+                const node_ptr &rl = r->left_son;
+                return make(red, make(black, l, data, rl->left_son), rl->data,
+                            balance_right(rl->right_son, r->data, paint(r->right_son, red)));
+            }
+            return make(red, l, data, r);
+        }
+
+        //右子树黑路径长度减少1后的平衡
+        static node_ptr repair_right(const node_ptr &l, const value_type &data, const node_ptr &r) {
+            if (is_red(r)) { return make(red, l, data, paint(r, black)); }
+            if (is_black(l)) { return balance_left(paint(l, red), data, r); }
+            if (is_red(l) && is_black(l->right_son)) {
+                const node_ptr &lr = l->right_son;
+                return make(red, balance_left(paint(l->left_son, red), l->data, lr->left_son), lr->data,
+                            make(black, lr->right_son, data, r));
+            }
+            return make(red, l, data, r);
+        }
+
+        //拼接两棵相邻的子树（l中所有key小于r中所有key），用于删除节点
+        static node_ptr combine(const node_ptr &l, const node_ptr &r) {
+            if (l == nullptr) { return r; }
+            if (r == nullptr) { return l; }
+            if (l->colour == red && r->colour == red) {
+                node_ptr mid = combine(l->right_son, r->left_son);
+                if (is_red(mid)) {
+                    return make(red, make(red, l->left_son, l->data, mid->left_son), mid->data,
+                                make(red, mid->right_son, r->data, r->right_son));
+                }
+                return make(red, l->left_son, l->data, make(red, mid, r->data, r->right_son));
+            }
+            if (l->colour == black && r->colour == black) {
+                node_ptr mid = combine(l->right_son, r->left_son);
+                if (is_red(mid)) {
+                    return make(red, make(black, l->left_son, l->data, mid->left_son), mid->data,
+                                make(black, mid->right_son, r->data, r->right_son));
+                }
+                return repair_left(l->left_son, l->data, make(black, mid, r->data, r->right_son));
+            }
+            if (r->colour == red) { return make(red, combine(l, r->left_son), r->data, r->right_son); }
+            return make(red, l->left_son, l->data, combine(l->right_son, r));
+        }
+
+        //返回插入后的新子树；key已存在时，assign为真则替换其值，否则原样返回p
+        static node_ptr insert_node(const node_ptr &p, const value_type &value, bool assign, bool &inserted) {
+            if (p == nullptr) {
+                inserted = true;
+                return make(red, nullptr, value, nullptr);
+            }
+            if (Compare()(value.first, p->data.first)) {
+                node_ptr l = insert_node(p->left_son, value, assign, inserted);
+                if (l == p->left_son) { return p; }//子树未变，无需复制
+                if (p->colour == black) { return balance_left(l, p->data, p->right_son); }
+                return make(red, l, p->data, p->right_son);
+            } else if (Compare()(p->data.first, value.first)) {
+                node_ptr r = insert_node(p->right_son, value, assign, inserted);
+                if (r == p->right_son) { return p; }
+                if (p->colour == black) { return balance_right(p->left_son, p->data, r); }
+                return make(red, p->left_son, p->data, r);
+            } else if (assign) {
+                return make(p->colour, p->left_son, value, p->right_son);
+            } else { return p; }
+        }
+
+        //返回删除key后的新子树，调用前须保证key存在
+        static node_ptr erase_node(const node_ptr &p, const Key &key) {
+            if (Compare()(key, p->data.first)) {
+                if (is_black(p->left_son)) {
+                    return repair_left(erase_node(p->left_son, key), p->data, p->right_son);
+                }
+                return make(red, erase_node(p->left_son, key), p->data, p->right_son);
+            } else if (Compare()(p->data.first, key)) {
+                if (is_black(p->right_son)) {
+                    return repair_right(p->left_son, p->data, erase_node(p->right_son, key));
+                }
+                return make(red, p->left_son, p->data, erase_node(p->right_son, key));
+            } else { return combine(p->left_son, p->right_son); }
+        }
+
+        static const node *find_node(const node *p, const Key &key) {
+            while (p != nullptr) {
+                if (Compare()(key, p->data.first)) {
+                    p = p->left_son.get();
+                } else if (Compare()(p->data.first, key)) {
+                    p = p->right_son.get();
+                } else { return p; }
+            }
+            return nullptr;
+        }
+
+        version_ptr load() const { return std::atomic_load(&now); }
+
+        void publish(const node_ptr &root, size_t siz) {
+            std::atomic_store(&now, version_ptr(new version(paint(root, black), siz)));
+        }
+
+        bool update(const value_type &value, bool assign) {
+            std::lock_guard<std::mutex> guard(write_lock);
+            version_ptr old = load();
+            bool inserted = false;
+            node_ptr root = insert_node(old->root, value, assign, inserted);
+            if (root == old->root) { return false; }
+            publish(root, old->siz + (inserted ? 1 : 0));
+            return inserted;
+        }
+
+    public:
+
+        /**
+         * iterator of a snapshot, it is valid as long as the snapshot it comes from.
+         * it keeps the path from root to the current node, so operator++ and operator-- are amortized O(1).
+         */
+        class const_iterator {
+
+            friend class snapshot;
+
+        private:
+            using difference_type = std::ptrdiff_t;
+            using value_type = persistent_map::value_type;
+            using pointer = const value_type *;
+            using reference = const value_type &;
+            using iterator_category = std::bidirectional_iterator_tag;
+
+            const version *ver;
+            const node *path[max_depth];//从根到当前节点的路径，depth为0时表示end()
+            int depth;
+
+            void push_min(const node *p) {
+                while (p != nullptr) {
+                    path[depth++] = p;
+                    p = p->left_son.get();
+                }
+            }
+
+            void push_max(const node *p) {
+                while (p != nullptr) {
+                    path[depth++] = p;
+                    p = p->right_son.get();
+                }
+            }
+
+        public:
+
+            const_iterator() : ver(nullptr), depth(0) {}
+
+            const_iterator(const const_iterator &other) : ver(other.ver), depth(other.depth) {
+                for (int i = 0; i < depth; ++i) { path[i] = other.path[i]; }
+            }
+
+            const_iterator &operator=(const const_iterator &other) {
+                ver = other.ver;
+                depth = other.depth;
+                for (int i = 0; i < depth; ++i) { path[i] = other.path[i]; }
+                return *this;
+            }
+
+            const_iterator operator++(int) {
+                const_iterator tmp(*this);
+                ++(*this);
+                return tmp;
+            }
+
+            const_iterator &operator++() {
+                if (depth == 0) { throw invalid_iterator(); }
+                const node *p = path[depth - 1];
+                if (p->right_son != nullptr) {
+                    push_min(p->right_son.get());
+                } else {//回退到第一个从左子树上来的祖先
+                    --depth;
+                    while (depth > 0 && path[depth - 1]->right_son.get() == p) {
+                        p = path[--depth];
+                    }
+                }
+                return *this;
+            }
+
+            const_iterator operator--(int) {
+                const_iterator tmp(*this);
+                --(*this);
+                return tmp;
+            }
+
+            const_iterator &operator--() {
+                if (ver == nullptr || ver->root == nullptr) { throw invalid_iterator(); }
+                if (depth == 0) {
+                    push_max(ver->root.get());
+                    return *this;
+                }
+                const node *p = path[depth - 1];
+                if (p->left_son != nullptr) {
+                    push_max(p->left_son.get());
+                } else {//回退到第一个从右子树上来的祖先
+                    int d = depth - 1;
+                    while (d > 0 && path[d - 1]->left_son.get() == p) { p = path[--d]; }
+                    if (d == 0) { throw invalid_iterator(); }//已是begin()
+                    depth = d;
+                }
+                return *this;
+            }
+
+            const value_type &operator*() const {
+                if (depth == 0) { throw runtime_error(); }
+                return path[depth - 1]->data;
+            }
+
+            const value_type *operator->() const noexcept { return &(path[depth - 1]->data); }
+
+            bool operator==(const const_iterator &rhs) const {
+                return ver == rhs.ver && depth == rhs.depth &&
+                       (depth == 0 || path[depth - 1] == rhs.path[depth - 1]);
+            }
+
+            bool operator!=(const const_iterator &rhs) const { return !(*this == rhs); }
+        };
+
+        /**
+         * an immutable version of the map.
+         * holding a snapshot keeps all its nodes alive; concurrent updates of the map never affect it.
+         */
+        class snapshot {
+
+            friend class persistent_map;
+
+        private:
+            version_ptr ver;
+
+            explicit snapshot(const version_ptr &ver_) : ver(ver_) {}
+
+        public:
+
+            snapshot() : ver(new version(nullptr, 0)) {}
+
+            size_t size() const { return ver->siz; }
+
+            bool empty() const { return ver->siz == 0; }
+
+            const T &at(const Key &key) const {
+                const node *p = find_node(ver->root.get(), key);
+                if (p == nullptr) { throw index_out_of_bound(); }
+                return p->data.second;
+            }
+
+            const T &operator[](const Key &key) const { return at(key); }
+
+            size_t count(const Key &key) const { return find_node(ver->root.get(), key) == nullptr ? 0 : 1; }
+
+            const_iterator cbegin() const {
+                const_iterator it;
+                it.ver = ver.get();
+                it.push_min(ver->root.get());
+                return it;
+            }
+
+            const_iterator cend() const {
+                const_iterator it;
+                it.ver = ver.get();
+                return it;
+            }
+
+            const_iterator find(const Key &key) const {
+                const_iterator it;
+                it.ver = ver.get();
+                const node *p = ver->root.get();
+                while (p != nullptr) {
+                    it.path[it.depth++] = p;
+                    if (Compare()(key, p->data.first)) {
+                        p = p->left_son.get();
+                    } else if (Compare()(p->data.first, key)) {
+                        p = p->right_son.get();
+                    } else { return it; }
+                }
+                it.depth = 0;
+                return it;
+            }
+        };
+
+        persistent_map() : now(new version(nullptr, 0)) {}
+
+        //复制只共享对方当前版本，O(1)
+        persistent_map(const persistent_map &other) : now(other.load()) {}
+
+        persistent_map &operator=(const persistent_map &other) {
+            if (&other == this) { return *this; }
+            std::lock_guard<std::mutex> guard(write_lock);
+            std::atomic_store(&now, other.load());
+            return *this;
+        }
+
+        //读者调用：取得当前版本的快照，不与写者互斥
+        snapshot get_snapshot() const { return snapshot(load()); }
+
+        size_t size() const { return load()->siz; }
+
+        bool empty() const { return load()->siz == 0; }
+
+        size_t count(const Key &key) const { return find_node(load()->root.get(), key) == nullptr ? 0 : 1; }
+
+        //key不存在时插入，返回是否插入成功
+        bool insert(const value_type &value) { return update(value, false); }
+
+        //key不存在时插入，存在时替换其值，返回是否为新插入
+        bool insert_or_assign(const Key &key, const T &value) { return update(value_type(key, value), true); }
+
+        //删除key对应的元素，返回删除的个数（0或1）
+        size_t erase(const Key &key) {
+            std::lock_guard<std::mutex> guard(write_lock);
+            version_ptr old = load();
+            if (find_node(old->root.get(), key) == nullptr) { return 0; }
+            publish(erase_node(old->root, key), old->siz - 1);
+            return 1;
+        }
+
+        void clear() {
+            std::lock_guard<std::mutex> guard(write_lock);
+            publish(nullptr, 0);
+        }
+    };
+}
+
+#endif
@@ -3,162 +3,146 @@
 
 #include <cstddef>
 #include <functional>
+#include <new>
+#include <utility>
 #include "exceptions.hpp"
+#include "node_pool.hpp"
 
 namespace sjtu {
 
-    template<typename T, class Compare = std::less<T>>
+    /**
+     * storage policy of priority_queue: a binomial heap of linked nodes, merge takes O(log n).
+     */
+    struct binomial_storage {
+    };
+
+    /**
+     * storage policy of priority_queue: an implicit D-ary heap in one contiguous buffer.
+     * push and pop touch O(log_D n) consecutive slots and allocate only when the buffer grows,
+     * while merge moves the elements of the smaller heap, O(m log n).
+     */
+    template<size_t D = 4>
+    struct dary_storage {
+        static_assert(D >= 2, "a d-ary heap needs D >= 2");
+    };
+
+    /**
+     * storage policy of priority_queue: an addressable pairing heap.
+     * push returns a handle of the element, which stays valid until the element is popped or
+     * erased, and can be passed to decrease_key, increase_key and erase. push, merge and
+     * decrease_key take O(1), pop, increase_key and erase O(log n) amortized.
+     */
+    struct pairing_storage {
+    };
+
+    template<typename T, class Compare = std::less<T>, class Storage = binomial_storage>
     class priority_queue {
     private:
 
         struct node {
             int height;
-            T *data;
             node *next_brother;
             node *first_son;
             node *last_son;
+            alignas(T) unsigned char storage[sizeof(T)];//元素与节点存放在一起，由push构造、pop析构
 
-
-            node(int height_ = -1, T *data_ = nullptr, node *next_brother_ = nullptr,
-                 node *first_son_ = nullptr, node *last_son_ = nullptr) {
+            explicit node(int height_ = -1) {
                 height = height_;
-                data = data_;
-                next_brother = next_brother_;
-                first_son = first_son_;
-                last_son = last_son_;
-            };
+                next_brother = nullptr;
+                first_son = nullptr;
+                last_son = nullptr;
+            }
 
+            T &value() { return *reinterpret_cast<T *>(storage); }
+
+            const T &value() const { return *reinterpret_cast<const T *>(storage); }
         };//二项树的节点
 
-        node *root;
+        node root;//哨兵，root.first_son起为按高度递增的根链表，其元素不构造
+        node *best;//堆顶所在的二项树的根，堆为空时为nullptr
+        node *best_pre;//根链表中best的前驱，best为第一个根时为nullptr
         int siz;
+        node_pool<node> pool;//回收的节点，push时优先复用
 
-        void traverse_copy(node *now_root, node *obj_root) {
-            if (obj_root->first_son == nullptr) { return; }
-            node *p_ = obj_root->first_son;
-            node *p = now_root->first_son = new node(p_->height, new T(*(p_->data)));
-            traverse_copy(p, p_);
-            while (p_->next_brother != nullptr) {
-                p_ = p_->next_brother;
-                p = p->next_brother = new node(p_->height, new T(*(p_->data)));
-                traverse_copy(p, p_);
+        //在根链表中找到最大的根，相同时取靠后的一个
+        void find_best() {
+            best = root.first_son;
+            best_pre = nullptr;
+            if (best == nullptr) { return; }
+            for (node *p_pre = best, *p = best->next_brother; p != nullptr; p_pre = p, p = p->next_brother) {
+                if (!Compare()(p->value(), best->value())) {
+                    best = p;
+                    best_pre = p_pre;
+                }
             }
-            now_root->last_son = p;
-            return;
         }
 
-        void traverse_delete(node *now_root) {
-            if (now_root->first_son == nullptr) {
-                delete now_root->data;
-                delete now_root;
-                return;
-            }
-            node *del = now_root->first_son, *p = del->next_brother;
-            traverse_delete(del);
-            while (p != nullptr) {
-                del = p;
-                p = p->next_brother;
-                traverse_delete(del);
+        //将同高的二项树son挂为p的最后一个儿子
+        static void link(node *p, node *son) {
+            if (p->last_son == nullptr) {
+                p->first_son = p->last_son = son;
+            } else {
+                p->last_son = p->last_son->next_brother = son;
             }
-            if (now_root->data != nullptr) { delete now_root->data; }
-            delete now_root;
-            return;
+            son->next_brother = nullptr;
+            ++p->height;
         }
 
-    public:
-
-        priority_queue() {
-            root = new node;
-            siz = 0;
-        }
-
-        priority_queue(const priority_queue &other) {
-            root = new node;
-            traverse_copy(root, other.root);
-            siz = other.siz;
+        //以args在新节点上构造元素，构造抛出异常时节点交还pool
+        template<class... Args>
+        node *create_node(Args &&... args) {
+            node *p = new(pool.allocate()) node(0);
+            try {
+                new(p->storage) T(std::forward<Args>(args)...);
+            } catch (...) {
+                p->~node();
+                pool.deallocate(p);
+                throw;
+            }
+            return p;
         }
 
-        ~priority_queue() {
-            traverse_delete(root);
+        void destroy_node(node *p) {
+            p->value().~T();
+            p->~node();
+            pool.deallocate(p);
         }
 
-        priority_queue &operator=(const priority_queue &other) {
-            if (this == &other) { return *this; }
-            else {
-                traverse_delete(root);
-                root = new node;
-                priority_queue tmp(other);
-                root->first_son = tmp.root->first_son;
-                tmp.root->first_son = nullptr;
-                siz = other.siz;
-                return *this;
-            }
-        }
-
-        const T &top() const {
-            if (empty()) { throw container_is_empty(); }
-            else {
-                node *p_top = root->first_son, *p = p_top->next_brother;
-                while (p != nullptr) {
-                    if (!Compare()(*(p->data), *(p_top->data))) {
-                        p_top = p;
-                    }
-                    p = p->next_brother;
+        //复制以p起的兄弟链表及其子树，last为复制后链表的最后一个节点；复制抛出异常时已复制的部分被释放
+        node *copy_list(const node *p, node *&last) {
+            node *first = nullptr;
+            last = nullptr;
+            try {
+                for (; p != nullptr; p = p->next_brother) {
+                    node *q = create_node(p->value());
+                    q->height = p->height;
+                    if (last == nullptr) { first = q; }
+                    else { last->next_brother = q; }
+                    last = q;
+                    q->first_son = copy_list(p->first_son, q->last_son);
                 }
-                return *(p_top->data);
+            } catch (...) {
+                delete_list(first);
+                throw;
             }
+            return first;
         }
 
-        void push(const T &e) {
-            try {//新插入节点仅可能与二项树的根节点进行比较
-                node *p = root->first_son;
-                int height = 0;
-                while (p != nullptr && Compare()(*(p->data), e) && p->height == height) {
-                    p = p->next_brother;
-                    ++height;
-                }//当且仅当新插入节点比当前树的根节点大、可向前连续合并时，方需继续比较
-            } catch (...) { return; }
-            priority_queue tmp;
-            tmp.root->first_son = new node(0, new T(e));
-            merge(tmp);
-            ++siz;
-        }
-
-        void pop() {
-            if (empty()) { throw container_is_empty(); }
-            else {
-                node *del = root->first_son, *del_pre = nullptr;
-                node *p_pre = del, *p = del->next_brother;
-                while (p != nullptr) {
-                    if (!Compare()(*(p->data), *(del->data))) {
-                        del = p;
-                        del_pre = p_pre;
-                    }
-                    p_pre = p;
-                    p = p->next_brother;
-                }
-                if (del_pre != nullptr) {
-                    del_pre->next_brother = del->next_brother;
-                } else {
-                    root->first_son = del->next_brother;
-                }
-                priority_queue tmp;
-                tmp.root->first_son = del->first_son;
-                delete del->data;
-                delete del;
-                merge(tmp);
-                --siz;
+        //释放以p起的兄弟链表及其子树
+        void delete_list(node *p) {
+            while (p != nullptr) {
+                node *del = p;
+                p = p->next_brother;
+                delete_list(del->first_son);
+                destroy_node(del);
             }
         }
 
-        size_t size() const { return siz; }
-
-        bool empty() const { return siz == 0; }
-
-        void merge(priority_queue &other) {
-            node *p = root->first_son, *p_ = other.root->first_son;
-            node *p_pre = new node, *p_new = new node;
-            node *del_pre = p_pre, *del_new = p_new;
+        //将以first起的根链表（按高度递增）合并进当前的根链表，不改变siz，合并后重新确定best
+        void meld(node *first) {
+            node *p = root.first_son, *p_ = first;
+            node dummy_pre, dummy_new;//两个哨兵在栈上，不分配内存
+            node *p_pre = &dummy_pre, *p_new = &dummy_new;
             p_pre->next_brother = p_new;
             bool flag = true;
             while ((p != nullptr || p_ != nullptr) && flag) {
@@ -168,7 +152,7 @@ namespace sjtu {
                     p_pre = p_pre->next_brother;
                     p = p->next_brother;
                 } else if (p != nullptr && p->height == p_new->height) {
-                    if (Compare()(*(p->data), *(p_new->data))) {
+                    if (Compare()(p->value(), p_new->value())) {
                         if (p_new->last_son == nullptr) {
                             p_new->first_son = p_new->last_son = p;
                         } else {
@@ -190,7 +174,7 @@ namespace sjtu {
                         p = p->next_brother;
                     }
                 } else if (p_ != nullptr && p_->height == p_new->height) {
-                    if (Compare()(*(p_->data), *(p_new->data))) {
+                    if (Compare()(p_->value(), p_new->value())) {
                         if (p_new->last_son == nullptr) {
                             p_new->first_son = p_new->last_son = p_;
                         } else {
@@ -226,11 +210,745 @@ namespace sjtu {
                 }
             }
             if (flag) { p_new->next_brother = nullptr; }
-            root->first_son = del_new->next_brother;
-            delete del_pre;
-            delete del_new;
-            other.root->first_son = nullptr;
+            root.first_son = dummy_new.next_brother;
+            find_best();
+        }
+
+        //将已构造元素的单个节点cur插入堆中，比较抛出异常时释放cur、堆不变
+        void push_node(node *cur) {
+            //新节点依次与高为0、1、2……的根进位合并，直到遇到缺少的高度
+            //先只做比较、记下每次合并的胜者，再统一挂接
+            unsigned long long p_win = 0;//第i位为1表示第i次合并中原有的根胜出
+            int carry = 0;
+            bool best_merged = false, pre_merged = false, new_best;
+            try {
+                const T *win = &cur->value();
+                for (node *p = root.first_son; p != nullptr && p->height == carry; p = p->next_brother, ++carry) {
+                    if (!Compare()(p->value(), *win)) {
+                        p_win |= 1ull << carry;
+                        win = &p->value();
+                    }
+                    if (p == best) { best_merged = true; }
+                    if (p == best_pre) { pre_merged = true; }
+                }
+                //原来的堆顶参与了合并时，新树的根即为堆顶
+                new_best = (best == nullptr || best_merged || !Compare()(*win, best->value()));
+            } catch (...) {
+                destroy_node(cur);
+                return;
+            }
+            node *p = root.first_son;
+            for (int i = 0; i < carry; ++i) {
+                node *next = p->next_brother;
+                if (p_win >> i & 1) {
+                    link(p, cur);
+                    cur = p;
+                } else { link(cur, p); }
+                p = next;
+            }
+            cur->next_brother = p;
+            root.first_son = cur;
+            if (new_best) {
+                best = cur;
+                best_pre = nullptr;
+            } else if (pre_merged || best_pre == nullptr) { best_pre = cur; }//新树排在best之前，且紧邻best
+            ++siz;
+        }
+
+        //以[first, last)中的元素建成二项树的森林，按高度递增串成根链表返回，n为元素个数
+        //与二进制计数相同：slot[h]存放高为h的树，新节点逐层与之合并进位，共O(n)次比较
+        //构造或比较抛出异常时释放已建的树，不影响当前的堆
+        template<class InputIterator>
+        node *build_forest(InputIterator first, InputIterator last, int &n) {
+            node *slot[64] = {};
+            n = 0;
+            try {
+                for (; first != last; ++first) {
+                    node *cur = create_node(*first);
+                    int h = 0;
+                    for (; slot[h] != nullptr; ++h) {
+                        bool slot_win;
+                        try {
+                            slot_win = !Compare()(slot[h]->value(), cur->value());
+                        } catch (...) {
+                            delete_list(cur);
+                            throw;
+                        }
+                        if (slot_win) {
+                            link(slot[h], cur);
+                            cur = slot[h];
+                        } else { link(cur, slot[h]); }
+                        slot[h] = nullptr;
+                    }
+                    slot[h] = cur;
+                    ++n;
+                }
+            } catch (...) {
+                for (int h = 0; h < 64; ++h) { delete_list(slot[h]); }
+                throw;
+            }
+            node *list = nullptr;
+            for (int h = 63; h >= 0; --h) {
+                if (slot[h] != nullptr) {
+                    slot[h]->next_brother = list;
+                    list = slot[h];
+                }
+            }
+            return list;
+        }
+
+    public:
+
+        priority_queue() {
+            best = best_pre = nullptr;
+            siz = 0;
+        }
+
+        //以[first, last)中的元素建堆，O(n)
+        template<class InputIterator>
+        priority_queue(InputIterator first, InputIterator last) {
+            best = best_pre = nullptr;
+            siz = 0;
+            push_range(first, last);
+        }
+
+        priority_queue(const priority_queue &other) {
+            node *last;
+            root.first_son = copy_list(other.root.first_son, last);
+            find_best();
+            siz = other.siz;
+        }
+
+        ~priority_queue() {
+            delete_list(root.first_son);
+        }
+
+        priority_queue &operator=(const priority_queue &other) {
+            if (this == &other) { return *this; }
+            else {
+                priority_queue tmp(other);
+                node *p = root.first_son;
+                root.first_son = tmp.root.first_son;
+                tmp.root.first_son = p;
+                best = tmp.best;
+                best_pre = tmp.best_pre;
+                siz = other.siz;
+                return *this;
+            }
+        }
+
+        const T &top() const {
+            if (empty()) { throw container_is_empty(); }
+            return best->value();
+        }
+
+        //比较抛出异常时不插入
+        void push(const T &e) { push_node(create_node(e)); }
+
+        void push(T &&e) { push_node(create_node(std::move(e))); }
+
+        //插入[first, last)中的元素：先单独建成二项树的森林，再与当前的堆合并一次，O(n + log size())
+        //建森林时构造或比较抛出异常，则不插入任何元素
+        template<class InputIterator>
+        void push_range(InputIterator first, InputIterator last) {
+            int n;
+            node *list = build_forest(first, last, n);
+            if (list == nullptr) { return; }
+            meld(list);
+            siz += n;
+        }
+
+        //在节点上直接以args构造元素
+        template<class... Args>
+        void emplace(Args &&... args) { push_node(create_node(std::forward<Args>(args)...)); }
+
+        void pop() {
+            if (empty()) { throw container_is_empty(); }
+            else {
+                node *del = best, *del_pre = best_pre;
+                if (del_pre != nullptr) {
+                    del_pre->next_brother = del->next_brother;
+                } else {
+                    root.first_son = del->next_brother;
+                }
+                node *sons = del->first_son;//儿子的高度递增，本身即为一条根链表
+                destroy_node(del);
+                meld(sons);
+                --siz;
+            }
+        }
+
+        //弹出堆顶并将其移动赋值给result，T只需可移动
+        void pop(T &result) {
+            if (empty()) { throw container_is_empty(); }
+            result = std::move(best->value());
+            pop();
+        }
+
+        size_t size() const { return siz; }
+
+        bool empty() const { return siz == 0; }
+
+        //将pool中缓存的空闲节点还给系统
+        void shrink_to_fit() { pool.release(); }
+
+        //other的节点直接并入当前的堆，other随后为空
+        void merge(priority_queue &other) {
+            if (this == &other) { return; }
+            node *first = other.root.first_son;
+            other.root.first_son = nullptr;
+            other.best = other.best_pre = nullptr;
+            siz += other.siz;
+            other.siz = 0;
+            meld(first);
+        }
+    };
+
+    template<typename T, class Compare, size_t D>
+    class priority_queue<T, Compare, dary_storage<D> > {
+    private:
+
+        T *data;//data[0]为堆顶，data[i]的儿子为data[i * D + 1]至data[i * D + D]
+        size_t siz;
+        size_t capacity;
+
+        static const size_t max_depth = 64;//D >= 2时堆的层数不超过64
+
+        inline static size_t father_of(size_t i) { return (i - 1) / D; }
+
+        void destroy() {
+            for (size_t i = 0; i < siz; ++i) { data[i].~T(); }
+            ::operator delete(data);
+        }
+
+        //容量不足n时按倍增扩容
+        void reserve(size_t n) {
+            if (n <= capacity) { return; }
+            size_t new_capacity = (capacity == 0 ? 16 : capacity * 2);
+            while (new_capacity < n) { new_capacity *= 2; }
+            reallocate(new_capacity);
+        }
+
+        //元素移入容量为new_capacity的新缓冲区；移动可能抛出异常时改为复制，失败时堆不变
+        void reallocate(size_t new_capacity) {
+            T *new_data = (new_capacity == 0 ? nullptr : static_cast<T *>(::operator new(new_capacity * sizeof(T))));
+            size_t i = 0;
+            try {
+                for (; i < siz; ++i) { new(new_data + i) T(std::move_if_noexcept(data[i])); }
+            } catch (...) {
+                while (i > 0) { new_data[--i].~T(); }
+                ::operator delete(new_data);
+                throw;
+            }
+            destroy();
+            data = new_data;
+            capacity = new_capacity;
+        }
+
+        //data[i]向上调整：先只做比较确定其位置，再沿路径把祖先依次下移，比较抛出异常时堆不变
+        void rise(size_t i) {
+            size_t pos = i;
+            while (pos > 0 && Compare()(data[father_of(pos)], data[i])) { pos = father_of(pos); }
+            if (pos == i) { return; }
+            T value(std::move(data[i]));
+            data[i].~T();
+            for (size_t j = i; j != pos; j = father_of(j)) {
+                new(data + j) T(std::move(data[father_of(j)]));
+                data[father_of(j)].~T();
+            }
+            new(data + pos) T(std::move(value));
+        }
+
+        //将data[from]从hole处下沉，from与hole不同时hole处原有的元素被丢弃，out不为空时先移动赋值给*out
+        //先沿路径比较、记下各层较大的儿子，再统一移动，比较抛出异常时堆不变
+        void sink(size_t hole, size_t from, T *out = nullptr) {
+            size_t path[max_depth], depth = 0;
+            for (size_t i = hole; i * D + 1 < siz;) {
+                size_t son = i * D + 1, best = son, last = (siz - son > D ? son + D : siz);
+                for (size_t k = son + 1; k < last; ++k) {
+                    if (Compare()(data[best], data[k])) { best = k; }
+                }
+                if (!Compare()(data[from], data[best])) { break; }
+                path[depth++] = i = best;
+            }
+            if (depth == 0 && from == hole) { return; }
+            if (out != nullptr) { *out = std::move(data[hole]); }
+            T value(std::move(data[from]));
+            data[from].~T();
+            if (from != hole) { data[hole].~T(); }
+            for (size_t k = 0; k < depth; ++k) {
+                new(data + hole) T(std::move(data[path[k]]));
+                data[path[k]].~T();
+                hole = path[k];
+            }
+            new(data + hole) T(std::move(value));
+        }
+
+        void swap_with(priority_queue &other) {
+            std::swap(data, other.data);
+            std::swap(siz, other.siz);
+            std::swap(capacity, other.capacity);
+        }
+
+    public:
+
+        priority_queue() : data(nullptr), siz(0), capacity(0) {}
+
+        //以[first, last)中的元素建堆，O(n)
+        template<class InputIterator>
+        priority_queue(InputIterator first, InputIterator last) : data(nullptr), siz(0), capacity(0) {
+            try {
+                push_range(first, last);
+            } catch (...) {
+                destroy();
+                throw;
+            }
+        }
+
+        priority_queue(const priority_queue &other) : data(nullptr), siz(0), capacity(0) {
+            if (other.siz == 0) { return; }
+            data = static_cast<T *>(::operator new(other.siz * sizeof(T)));
+            capacity = other.siz;
+            try {
+                for (; siz < other.siz; ++siz) { new(data + siz) T(other.data[siz]); }
+            } catch (...) {
+                destroy();
+                throw;
+            }
+        }
+
+        ~priority_queue() { destroy(); }
+
+        priority_queue &operator=(const priority_queue &other) {
+            if (this == &other) { return *this; }
+            priority_queue tmp(other);
+            swap_with(tmp);
+            return *this;
+        }
+
+        const T &top() const {
+            if (empty()) { throw container_is_empty(); }
+            return data[0];
+        }
+
+        //与二项堆一致，比较抛出异常时不插入
+        void push(const T &e) { emplace(e); }
+
+        void push(T &&e) { emplace(std::move(e)); }
+
+        //在缓冲区末尾直接以args构造元素
+        template<class... Args>
+        void emplace(Args &&... args) {
+            if (siz == capacity) {//args可能引用堆中的元素，扩容前先构造
+                T value(std::forward<Args>(args)...);
+                reserve(siz + 1);
+                new(data + siz) T(std::move(value));
+            } else { new(data + siz) T(std::forward<Args>(args)...); }
+            ++siz;
+            try {
+                rise(siz - 1);
+            } catch (...) {
+                data[--siz].~T();
+            }
+        }
+
+        //插入[first, last)中的元素，先全部放在缓冲区末尾
+        //堆原为空时自底向上建堆（Floyd），自最后一个有儿子的节点起逐个下沉，共O(n)次比较，
+        //构造或比较抛出异常时堆仍为空；否则逐个向上调整，随机的元素平均每个只需O(1)次比较，
+        //比较抛出异常时只保留已调整的元素
+        template<class InputIterator>
+        void push_range(InputIterator first, InputIterator last) {
+            size_t old_siz = siz;
+            try {
+                for (; first != last; ++first) {
+                    if (siz == capacity) {
+                        T value(*first);
+                        reserve(siz + 1);
+                        new(data + siz) T(std::move(value));
+                    } else { new(data + siz) T(*first); }
+                    ++siz;
+                }
+                if (old_siz == 0) {
+                    for (size_t i = (siz < 2 ? 0 : (siz - 2) / D + 1); i > 0; --i) { sink(i - 1, i - 1); }
+                } else {
+                    for (; old_siz < siz; ++old_siz) { rise(old_siz); }
+                }
+            } catch (...) {
+                while (siz > old_siz) { data[--siz].~T(); }
+                throw;
+            }
+        }
+
+        //最后一个元素从堆顶下沉，比较抛出异常时堆不变
+        void pop() {
+            if (empty()) { throw container_is_empty(); }
+            --siz;
+            if (siz == 0) {
+                data[0].~T();
+                return;
+            }
+            try {
+                sink(0, siz);
+            } catch (...) {
+                ++siz;
+                throw;
+            }
+        }
+
+        //弹出堆顶并将其移动赋值给result，T只需可移动；比较抛出异常时堆不变
+        void pop(T &result) {
+            if (empty()) { throw container_is_empty(); }
+            if (siz == 1) {
+                result = std::move(data[0]);
+                data[--siz].~T();
+                return;
+            }
+            --siz;
+            try {
+                sink(0, siz, &result);
+            } catch (...) {
+                ++siz;
+                throw;
+            }
+        }
+
+        size_t size() const { return siz; }
+
+        bool empty() const { return siz == 0; }
+
+        //把缓冲区缩小到恰好容纳现有的元素
+        void shrink_to_fit() {
+            if (capacity > siz) { reallocate(siz); }
+        }
+
+        //较小一方的元素移入较大一方的缓冲区后逐个向上调整，other随后为空
+        void merge(priority_queue &other) {
+            if (this == &other || other.siz == 0) { return; }
+            if (other.siz > siz) { swap_with(other); }
+            reserve(siz + other.siz);
+            size_t old_siz = siz;
+            for (size_t i = 0; i < other.siz; ++i) {
+                new(data + siz) T(std::move(other.data[i]));
+                other.data[i].~T();
+                ++siz;
+            }
+            other.siz = 0;
+            for (size_t i = old_siz; i < siz; ++i) { rise(i); }
+        }
+    };
+
+    template<typename T, class Compare>
+    class priority_queue<T, Compare, pairing_storage> {
+    private:
+
+        struct node {
+            node *child;//第一个儿子
+            node *next;//下一个兄弟
+            node *prev;//第一个儿子的prev为父亲，其余为上一个兄弟，根的prev为nullptr
+            alignas(T) unsigned char storage[sizeof(T)];
+
+            node() : child(nullptr), next(nullptr), prev(nullptr) {}
+
+            T &value() { return *reinterpret_cast<T *>(storage); }
+
+            const T &value() const { return *reinterpret_cast<const T *>(storage); }
+        };
+
+        node *root;
+        size_t siz;
+        node_pool<node> pool;
+
+        template<class... Args>
+        node *create_node(Args &&... args) {
+            node *p = new(pool.allocate()) node;
+            try {
+                new(p->storage) T(std::forward<Args>(args)...);
+            } catch (...) {
+                p->~node();
+                pool.deallocate(p);
+                throw;
+            }
+            return p;
+        }
+
+        void destroy_node(node *p) {
+            p->value().~T();
+            p->~node();
+            pool.deallocate(p);
+        }
+
+        //释放以p为根的树。不断把儿子转到链表的头部，不用递归，树再深也不会栈溢出
+        void delete_tree(node *p) {
+            while (p != nullptr) {
+                if (p->child != nullptr) {
+                    node *c = p->child;
+                    p->child = c->next;//c的兄弟改作p的儿子
+                    c->next = p;
+                    p = c;
+                } else {
+                    node *del = p;
+                    p = p->next;
+                    destroy_node(del);
+                }
+            }
+        }
+
+        //先序遍历中p的下一个节点
+        static const node *preorder_next(const node *p) {
+            if (p->child != nullptr) { return p->child; }
+            while (p != nullptr) {
+                if (p->next != nullptr) { return p->next; }
+                while (p->prev != nullptr && p->prev->child != p) { p = p->prev; }//回到第一个兄弟
+                p = p->prev;//父亲
+            }
+            return nullptr;
+        }
+
+        //将儿子c挂为p的第一个儿子，c须为单独的树
+        static void add_child(node *p, node *c) {
+            c->next = p->child;
+            if (p->child != nullptr) { p->child->prev = c; }
+            c->prev = p;
+            p->child = c;
+        }
+
+        //合并两棵单独的树，返回新根，相同时a为根
+        static node *meld(node *a, node *b) {
+            if (a == nullptr) { return b; }
+            if (b == nullptr) { return a; }
+            if (Compare()(a->value(), b->value())) {
+                add_child(b, a);
+                return b;
+            }
+            add_child(a, b);
+            return a;
+        }
+
+        //将p从父亲的儿子链表中摘下，成为单独的树
+        static void cut(node *p) {
+            if (p->prev->child == p) {
+                p->prev->child = p->next;
+            } else { p->prev->next = p->next; }
+            if (p->next != nullptr) { p->next->prev = p->prev; }
+            p->prev = p->next = nullptr;
+        }
+
+        //两趟合并以first起的兄弟链表，返回合并后的根：先从左到右两两合并，再从右到左依次合并，均不用递归
+        static node *two_pass(node *first) {
+            if (first == nullptr) { return nullptr; }
+            node *pairs = nullptr;//第一趟的结果，以next逆序串起
+            while (first != nullptr) {
+                node *a = first, *b = first->next;
+                first = (b == nullptr ? nullptr : b->next);
+                a->prev = a->next = nullptr;
+                if (b != nullptr) { b->prev = b->next = nullptr; }
+                node *w = meld(a, b);
+                w->next = pairs;
+                pairs = w;
+            }
+            node *result = pairs;
+            pairs = pairs->next;
+            result->next = nullptr;
+            while (pairs != nullptr) {
+                node *w = pairs;
+                pairs = pairs->next;
+                w->next = nullptr;
+                result = meld(w, result);
+            }
+            return result;
+        }
+
+        //以value替换p的元素，先复制再析构，复制抛出异常时元素不变
+        static void replace_value(node *p, const T &value) {
+            T tmp(value);
+            p->value().~T();
+            new(p->storage) T(std::move(tmp));
+        }
+
+    public:
+
+        /**
+         * refers to an element in the heap, until the element is popped or erased.
+         */
+        class handle {
+            friend class priority_queue;
+
+        private:
+            node *point;
+
+            explicit handle(node *point_) : point(point_) {}
+
+        public:
+            handle() : point(nullptr) {}
+
+            const T &operator*() const { return point->value(); }
+
+            const T *operator->() const noexcept { return &(point->value()); }
+
+            bool operator==(const handle &rhs) const { return point == rhs.point; }
+
+            bool operator!=(const handle &rhs) const { return point != rhs.point; }
+        };
+
+        priority_queue() : root(nullptr), siz(0) {}
+
+        //以[first, last)中的元素建堆，O(n)
+        template<class InputIterator>
+        priority_queue(InputIterator first, InputIterator last) : root(nullptr), siz(0) { push_range(first, last); }
+
+        //按先序逐个插入other的元素，O(n)，新堆的形状与other不同，other的handle不能用于新堆
+        priority_queue(const priority_queue &other) : root(nullptr), siz(0) {
+            try {
+                for (const node *p = other.root; p != nullptr; p = preorder_next(p)) { push(p->value()); }
+            } catch (...) {
+                delete_tree(root);
+                throw;
+            }
+        }
+
+        ~priority_queue() { delete_tree(root); }
+
+        priority_queue &operator=(const priority_queue &other) {
+            if (this == &other) { return *this; }
+            priority_queue tmp(other);
+            node *p = root;
+            root = tmp.root;
+            tmp.root = p;
+            size_t n = siz;
+            siz = tmp.siz;
+            tmp.siz = n;
+            return *this;
+        }
+
+        const T &top() const {
+            if (empty()) { throw container_is_empty(); }
+            return root->value();
+        }
+
+        //返回新元素的handle，与二项堆一致，比较抛出异常时不插入，返回空的handle
+        handle push(const T &e) { return emplace(e); }
+
+        handle push(T &&e) { return emplace(std::move(e)); }
+
+        template<class... Args>
+        handle emplace(Args &&... args) {
+            node *p = create_node(std::forward<Args>(args)...);
+            try {
+                root = meld(root, p);
+            } catch (...) {
+                destroy_node(p);
+                return handle();
+            }
+            ++siz;
+            return handle(p);
+        }
+
+        //插入[first, last)中的元素，不返回handle
+        //与二项堆建森林相同，slot[h]存放由2^h个元素两两合并成的树，新节点逐层与之合并进位，
+        //最后把各slot中的树合并起来，再与当前的堆合并，共O(n)次比较，且只访问最近建的节点
+        //构造或比较抛出异常时不插入任何元素
+        template<class InputIterator>
+        void push_range(InputIterator first, InputIterator last) {
+            node *slot[64] = {}, *cur = nullptr;
+            size_t n = 0;
+            try {
+                for (; first != last; ++first) {
+                    cur = create_node(*first);
+                    int h = 0;
+                    for (; slot[h] != nullptr; ++h) {
+                        cur = meld(slot[h], cur);//meld先比较再修改，抛出异常时两棵树不变
+                        slot[h] = nullptr;
+                    }
+                    slot[h] = cur;
+                    cur = nullptr;
+                    ++n;
+                }
+                for (int h = 0; h < 64; ++h) {
+                    if (slot[h] == nullptr) { continue; }
+                    cur = meld(slot[h], cur);
+                    slot[h] = nullptr;
+                }
+                root = meld(root, cur);
+            } catch (...) {
+                delete_tree(cur);
+                for (int h = 0; h < 64; ++h) { delete_tree(slot[h]); }
+                throw;
+            }
+            siz += n;
+        }
+
+        void pop() {
+            if (empty()) { throw container_is_empty(); }
+            node *del = root;
+            root = two_pass(root->child);
+            destroy_node(del);
+            --siz;
+        }
+
+        //弹出堆顶并将其移动赋值给result，T只需可移动
+        void pop(T &result) {
+            if (empty()) { throw container_is_empty(); }
+            result = std::move(root->value());
+            pop();
+        }
+
+        //将h所指的元素改为value，value须不比原来的元素小（即向堆顶移动），否则抛出runtime_error，O(1)
+        //比较或复制抛出异常时堆不变
+        void decrease_key(handle h, const T &value) {
+            node *p = h.point;
+            if (p == nullptr) { throw invalid_iterator(); }
+            if (Compare()(value, p->value())) { throw runtime_error(); }
+            bool p_top = (p != root && Compare()(root->value(), value));
+            replace_value(p, value);
+            if (p == root) { return; }
+            cut(p);
+            if (p_top) {
+                add_child(p, root);
+                root = p;
+            } else { add_child(root, p); }
+        }
+
+        //将h所指的元素改为value，value须不比原来的元素大（即远离堆顶），否则抛出runtime_error，O(log n)均摊
+        void increase_key(handle h, const T &value) {
+            node *p = h.point;
+            if (p == nullptr) { throw invalid_iterator(); }
+            if (Compare()(p->value(), value)) { throw runtime_error(); }
+            replace_value(p, value);
+            if (p == root) {
+                root = nullptr;
+            } else { cut(p); }
+            node *sons = two_pass(p->child);
+            p->child = nullptr;
+            root = meld(meld(root, sons), p);
+        }
+
+        //删除h所指的元素，O(log n)均摊
+        void erase(handle h) {
+            node *p = h.point;
+            if (p == nullptr) { throw invalid_iterator(); }
+            if (p == root) {
+                pop();
+                return;
+            }
+            cut(p);
+            root = meld(root, two_pass(p->child));
+            destroy_node(p);
+            --siz;
+        }
+
+        size_t size() const { return siz; }
+
+        bool empty() const { return siz == 0; }
+
+        //将pool中缓存的空闲节点还给系统
+        void shrink_to_fit() { pool.release(); }
+
+        //other的元素直接并入当前的堆，other的handle随之转为当前堆的handle，O(1)
+        void merge(priority_queue &other) {
+            if (this == &other) { return; }
+            root = meld(root, other.root);
             siz += other.siz;
+            other.root = nullptr;
             other.siz = 0;
         }
     };
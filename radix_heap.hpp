@@ -0,0 +1,252 @@
+/**
+ * implement a radix heap for monotone integer priorities
+ */
+#ifndef SJTU_RADIX_HEAP_HPP
+#define SJTU_RADIX_HEAP_HPP
+
+#include <cstddef>
+#include <climits>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "exceptions.hpp"
+#include "utility.hpp"
+
+namespace sjtu {
+
+    /**
+     * a min-heap of (key, value) pairs with integer keys, for workloads whose keys never go below
+     * the key last seen at the top (Dijkstra with non-negative weights, timers, event simulation).
+     * elements are kept in buckets by the highest bit in which their key differs from that last
+     * key; pop only redistributes a bucket when the smallest one runs empty, and every element
+     * moves to a lower bucket each time, so push takes O(1) and pop O(log C) amortized, where
+     * C is the range of the keys. keys are compared as integers only, no Compare is called.
+     * unless NDEBUG is defined, push throws runtime_error when its key is less than that of the
+     * element last returned by top or pop.
+     */
+    template<class Key, class Value>
+    class radix_heap {
+        static_assert(std::is_integral<Key>::value, "radix_heap needs an integral key");
+
+    public:
+
+        typedef pair<Key, Value> value_type;
+
+    private:
+
+        typedef typename std::make_unsigned<Key>::type ukey;
+
+        static const int key_bits = int(sizeof(Key) * CHAR_BIT);
+        static const int bucket_count = key_bits + 1;
+
+        //有符号的key翻转符号位，使无符号的大小关系与原来一致
+        inline static ukey to_unsigned(Key key) {
+            ukey u = ukey(key);
+            if (std::is_signed<Key>::value) { u ^= ukey(ukey(1) << (key_bits - 1)); }
+            return u;
+        }
+
+        //与base相同的key在0号桶，否则在二者最高的不同位加1号桶
+        inline static int bucket_of(ukey key, ukey base) {
+            if (key == base) { return 0; }
+            unsigned long long diff = (unsigned long long) (key ^ base);
+#ifdef __GNUC__
+            return int(sizeof(unsigned long long) * CHAR_BIT) - __builtin_clzll(diff);
+#else
+            int b = 0;
+            while (diff != 0) {
+                diff >>= 1;
+                ++b;
+            }
+            return b;
+#endif
+        }
+
+        //一段连续的缓冲区，倍增扩容，清空时保留内存
+        class bucket {
+        private:
+            value_type *data;
+            size_t siz;
+            size_t capacity;
+
+            void destroy() {
+                clear();
+                ::operator delete(data);
+            }
+
+        public:
+            bucket() : data(nullptr), siz(0), capacity(0) {}
+
+            bucket(const bucket &other) : data(nullptr), siz(0), capacity(0) {
+                reserve(other.siz);
+                try {
+                    for (; siz < other.siz; ++siz) { new(data + siz) value_type(other.data[siz]); }
+                } catch (...) {
+                    destroy();
+                    throw;
+                }
+            }
+
+            bucket &operator=(const bucket &other) = delete;
+
+            ~bucket() { destroy(); }
+
+            //保证能再放下n个元素
+            void reserve(size_t n) {
+                n += siz;
+                if (n <= capacity) { return; }
+                size_t new_capacity = (capacity == 0 ? 16 : capacity * 2);
+                while (new_capacity < n) { new_capacity *= 2; }
+                value_type *new_data = static_cast<value_type *>(::operator new(new_capacity * sizeof(value_type)));
+                size_t i = 0;
+                try {
+                    for (; i < siz; ++i) { new(new_data + i) value_type(std::move_if_noexcept(data[i])); }
+                } catch (...) {
+                    while (i > 0) { new_data[--i].~value_type(); }
+                    ::operator delete(new_data);
+                    throw;
+                }
+                for (i = 0; i < siz; ++i) { data[i].~value_type(); }
+                ::operator delete(data);
+                data = new_data;
+                capacity = new_capacity;
+            }
+
+            value_type &operator[](size_t i) { return data[i]; }
+
+            const value_type &back() const { return data[siz - 1]; }
+
+            template<class U>
+            void push_back(U &&e) {
+                if (siz == capacity) {//先在栈上构造，以防e引用了本桶中的元素
+                    value_type tmp(std::forward<U>(e));
+                    reserve(1);
+                    new(data + siz) value_type(std::move(tmp));
+                } else { new(data + siz) value_type(std::forward<U>(e)); }
+                ++siz;
+            }
+
+            void pop_back() { data[--siz].~value_type(); }
+
+            void clear() {
+                while (siz > 0) { data[--siz].~value_type(); }
+            }
+
+            void swap(bucket &other) {
+                std::swap(data, other.data);
+                std::swap(siz, other.siz);
+                std::swap(capacity, other.capacity);
+            }
+
+            size_t size() const { return siz; }
+
+            bool empty() const { return siz == 0; }
+        };
+
+        //buckets[0]中的key均等于last，buckets[i]中的key与last最高的不同位为第i-1位
+        mutable bucket buckets[bucket_count];
+        mutable ukey last;//最近一次top或pop所见的key，之后插入的key不得小于它
+        size_t siz;
+
+        //0号桶为空时，取第一个非空的桶中最小的key为last，把该桶的元素移到更小的桶中
+        //先为各桶预留空间再移动元素；分配或复制抛出异常时撤销已复制的元素，堆不变
+        void refill() const {
+            if (!buckets[0].empty()) { return; }
+            int i = 1;
+            while (buckets[i].empty()) { ++i; }
+            bucket &from = buckets[i];
+            ukey low = to_unsigned(from[0].first);
+            for (size_t j = 1; j < from.size(); ++j) {
+                ukey k = to_unsigned(from[j].first);
+                if (k < low) { low = k; }
+            }
+            size_t count[bucket_count] = {};
+            for (size_t j = 0; j < from.size(); ++j) { ++count[bucket_of(to_unsigned(from[j].first), low)]; }
+            for (int k = 0; k < i; ++k) {
+                if (count[k] > 0) { buckets[k].reserve(count[k]); }
+            }
+            size_t j = 0;
+            try {
+                for (; j < from.size(); ++j) {
+                    buckets[bucket_of(to_unsigned(from[j].first), low)].push_back(std::move_if_noexcept(from[j]));
+                }
+            } catch (...) {
+                while (j > 0) {
+                    --j;
+                    buckets[bucket_of(to_unsigned(from[j].first), low)].pop_back();
+                }
+                throw;
+            }
+            last = low;
+            from.clear();
+        }
+
+        void check_monotone(Key key) const {
+#ifndef NDEBUG
+            if (to_unsigned(key) < last) { throw runtime_error(); }
+#else
+            (void) key;
+#endif
+        }
+
+    public:
+
+        radix_heap() : last(0), siz(0) {}
+
+        radix_heap(const radix_heap &other) : last(other.last), siz(other.siz) {
+            for (int i = 0; i < bucket_count; ++i) {
+                bucket tmp(other.buckets[i]);
+                buckets[i].swap(tmp);
+            }
+        }
+
+        radix_heap &operator=(const radix_heap &other) {
+            if (this == &other) { return *this; }
+            radix_heap tmp(other);
+            for (int i = 0; i < bucket_count; ++i) { buckets[i].swap(tmp.buckets[i]); }
+            last = tmp.last;
+            siz = tmp.siz;
+            return *this;
+        }
+
+        const value_type &top() const {
+            if (empty()) { throw container_is_empty(); }
+            refill();
+            return buckets[0].back();
+        }
+
+        //key须不小于最近一次top或pop所见的key
+        void push(const Key &key, const Value &value) {
+            check_monotone(key);
+            buckets[bucket_of(to_unsigned(key), last)].push_back(value_type(key, value));
+            ++siz;
+        }
+
+        void push(const value_type &e) {
+            check_monotone(e.first);
+            buckets[bucket_of(to_unsigned(e.first), last)].push_back(e);
+            ++siz;
+        }
+
+        //弹出key最小的元素，key相同的元素之间顺序不定
+        void pop() {
+            if (empty()) { throw container_is_empty(); }
+            refill();
+            buckets[0].pop_back();
+            --siz;
+        }
+
+        size_t size() const { return siz; }
+
+        bool empty() const { return siz == 0; }
+
+        //清空后不再限制插入的key
+        void clear() {
+            for (int i = 0; i < bucket_count; ++i) { buckets[i].clear(); }
+            last = 0;
+            siz = 0;
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,27 @@
+/**
+ * implement containers like std::set and std::multiset on top of sjtu::map
+ */
+#ifndef SJTU_SET_HPP
+#define SJTU_SET_HPP
+
+#include <functional>
+#include "map.hpp"
+
+namespace sjtu {
+
+    /**
+     * a set of keys: a map whose nodes store the key only, with value_type const Key.
+     * insert, erase, find, count, lower_bound, upper_bound, split, join, erase_if and
+     * set_union / set_intersection / set_difference work as for map.
+     */
+    template<class Key, class Compare = std::less<Key> >
+    using set = map<Key, map_key_only, Compare>;
+
+    /**
+     * a set allowing equivalent keys, kept in insertion order among themselves.
+     */
+    template<class Key, class Compare = std::less<Key> >
+    using multiset = map<Key, map_key_only, Compare, map_no_augment, true>;
+}
+
+#endif
@@ -0,0 +1,684 @@
+/**
+ * implement a lock-free ordered map by skip list
+ */
+#ifndef SJTU_SKIPLIST_MAP_HPP
+#define SJTU_SKIPLIST_MAP_HPP
+
+#include <functional>
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <cassert>
+#include "utility.hpp"
+#include "exceptions.hpp"
+
+namespace sjtu {
+
+    /**
+     * epoch based memory reclamation shared by all lock-free containers.
+     * a thread enters an epoch before touching shared nodes and leaves it afterwards.
+     * a retired node is freed only after the global epoch has advanced twice since its retirement,
+     * which means every thread that might still see it has left its critical section.
+     * each thread takes one of max_threads slots on its first enter and keeps it until it exits;
+     * the enter that would need one more slot than that throws runtime_error.
+     */
+    class epoch_domain {
+    public:
+
+        struct retired {
+            retired *retire_next;
+            void (*deleter)(retired *);
+        };//需延迟回收的对象以此为基类，由deleter负责释放
+
+    private:
+
+        static const int max_threads = 256;
+        static const int advance_period = 64;//每退休这么多个对象尝试推进一次全局epoch
+
+        struct alignas(64) slot {
+            std::atomic<bool> used;
+            std::atomic<bool> active;
+            std::atomic<unsigned long> epoch;//进入临界区时看到的全局epoch
+            int nest;//以下成员只由持有该槽位的线程访问
+            int retire_count;
+            retired *limbo[3];
+            unsigned long limbo_epoch[3];
+        };
+
+        struct slot_holder {
+            int id = -1;
+
+            ~slot_holder() {
+                if (id >= 0) { instance().release(id); }
+            }
+        };//线程退出时归还槽位，其中尚未回收的对象留给下一个持有者
+
+        std::atomic<unsigned long> global_epoch;
+        slot slots[max_threads];
+
+        epoch_domain() : global_epoch(2) {
+            for (int i = 0; i < max_threads; ++i) {
+                slots[i].used = false;
+                slots[i].active = false;
+                slots[i].epoch = 0;
+                slots[i].nest = slots[i].retire_count = 0;
+                for (int j = 0; j < 3; ++j) {
+                    slots[i].limbo[j] = nullptr;
+                    slots[i].limbo_epoch[j] = 0;
+                }
+            }
+        }
+
+        static void free_list(retired *p) {
+            while (p != nullptr) {
+                retired *del = p;
+                p = p->retire_next;
+                del->deleter(del);
+            }
+        }
+
+        slot &my_slot() {
+            static thread_local slot_holder holder;
+            if (holder.id < 0) {
+                for (int i = 0; i < max_threads; ++i) {
+                    bool expected = false;
+                    if (!slots[i].used.load() && slots[i].used.compare_exchange_strong(expected, true)) {
+                        holder.id = i;
+                        break;
+                    }
+                }
+                if (holder.id < 0) { throw runtime_error(); }//同时存在的线程过多
+            }
+            return slots[holder.id];
+        }
+
+        void release(int id) {
+            slots[id].active = false;
+            slots[id].nest = 0;
+            slots[id].used = false;
+        }
+
+        //释放至少两个epoch以前退休的对象
+        void collect(slot &s, unsigned long now) {
+            for (int i = 0; i < 3; ++i) {
+                if (s.limbo[i] != nullptr && s.limbo_epoch[i] + 2 <= now) {
+                    free_list(s.limbo[i]);
+                    s.limbo[i] = nullptr;
+                }
+            }
+        }
+
+        //所有处于临界区的线程都已看到当前epoch时，推进全局epoch
+        void try_advance() {
+            unsigned long now = global_epoch.load();
+            for (int i = 0; i < max_threads; ++i) {
+                if (slots[i].used.load() && slots[i].active.load() && slots[i].epoch.load() != now) { return; }
+            }
+            global_epoch.compare_exchange_strong(now, now + 1);
+        }
+
+    public:
+
+        epoch_domain(const epoch_domain &other) = delete;
+
+        epoch_domain &operator=(const epoch_domain &other) = delete;
+
+        ~epoch_domain() {
+            for (int i = 0; i < max_threads; ++i) {
+                for (int j = 0; j < 3; ++j) { free_list(slots[i].limbo[j]); }
+            }
+        }
+
+        static epoch_domain &instance() {
+            static epoch_domain domain;
+            return domain;
+        }
+
+        //返回当前线程的槽位编号，离开时交给exit
+        int enter() {
+            slot &s = my_slot();
+            int id = int(&s - slots);
+            if (s.nest++ > 0) { return id; }//支持嵌套进入
+            s.active.store(true);
+            unsigned long now = global_epoch.load();
+            s.epoch.store(now);
+            collect(s, now);
+            return id;
+        }
+
+        //须由进入时的线程调用：nest只属于持有槽位的线程，在其他线程上离开会破坏它，使epoch无法再推进
+        void exit(int id) {
+            slot &s = slots[id];
+            assert(&s == &my_slot() && "an epoch must be left on the thread that entered it");
+            if (--s.nest == 0) { s.active.store(false); }
+        }
+
+        //p已从数据结构中摘除，调用者须处于临界区内
+        //按摘除后看到的全局epoch记录，而非本线程进入时的epoch：后者可能落后，据此回收会过早
+        void retire(retired *p) {
+            slot &s = my_slot();
+            unsigned long now = global_epoch.load();
+            int index = now % 3;
+            if (s.limbo_epoch[index] != now) {//该链表中的对象至少是三个epoch以前退休的
+                free_list(s.limbo[index]);
+                s.limbo[index] = nullptr;
+                s.limbo_epoch[index] = now;
+            }
+            p->retire_next = s.limbo[index];
+            s.limbo[index] = p;
+            if (++s.retire_count % advance_period == 0) { try_advance(); }
+        }
+    };
+
+    //在作用域内处于epoch临界区，须在构造它的线程上析构
+    class epoch_guard {
+    private:
+
+        int slot_id;//进入时的槽位，析构时据此检查是否仍在同一线程
+
+    public:
+
+        epoch_guard() : slot_id(epoch_domain::instance().enter()) {}
+
+        epoch_guard(const epoch_guard &) : slot_id(epoch_domain::instance().enter()) {}
+
+        epoch_guard &operator=(const epoch_guard &) { return *this; }//各自属于构造时的线程，不交换槽位
+
+        ~epoch_guard() { epoch_domain::instance().exit(slot_id); }
+    };
+
+    /**
+     * a lock-free ordered map with the interface of sjtu::map.
+     * insert links a node bottom-up with CAS; erase first marks the node's links (logical delete)
+     * and then unlinks it (physical delete). unlinked nodes are reclaimed by epoch_domain.
+     *
+     * find/insert/erase/count and iteration can be called from any number of threads concurrently.
+     * an iterator keeps its thread inside an epoch, so the node it points to stays readable even if
+     * another thread erases it. references returned by at/operator[] are not protected this way.
+     * clear, copy and destruction must not run concurrently with other operations.
+     *
+     * limits of the epoch scheme:
+     * - an iterator must be destroyed on the thread that created or copied it. the epoch nesting
+     *   count is per-thread state; leaving it from another thread (asserted in debug builds) would
+     *   leave a slot active forever, after which the epoch never advances and nothing is reclaimed.
+     * - while any thread holds an iterator, the global epoch cannot advance past it, so no retired
+     *   node of any lock-free container is freed. keep iterators short-lived.
+     * - at most 256 threads can use the domain at the same time; a slot is returned when its thread
+     *   exits. the first access from one more thread throws runtime_error.
+     */
+    template<
+            class Key,
+            class T,
+            class Compare = std::less<Key>
+    >
+    class skiplist_map {
+    public:
+
+        typedef pair<const Key, T> value_type;
+
+        class iterator;
+
+        class const_iterator;
+
+    private:
+
+        static const int max_level = 32;
+
+        struct node;
+
+        struct link_node : epoch_domain::retired {
+            int level;
+            std::atomic<uintptr_t> *next;//各层的后继，最低位为删除标记
+
+            explicit link_node(int level_) : level(level_) {
+                next = new std::atomic<uintptr_t>[level];
+                for (int i = 0; i < level; ++i) { next[i].store(0); }
+            }
+
+            ~link_node() { delete[] next; }
+        };//头节点只含各层链接，不含数据
+
+        struct node : link_node {
+            std::atomic<int> owners;//插入者与删除者都完成后才可回收
+            value_type data;
+
+            node(int level_, const value_type &data_) : link_node(level_), owners(2), data(data_) {
+                this->deleter = destroy;
+            }
+
+            static void destroy(epoch_domain::retired *p) { delete static_cast<node *>(p); }
+        };
+
+        link_node *head;
+        std::atomic<int> height;//当前使用的最高层数
+        std::atomic<size_t> siz;
+
+        inline static node *ptr_of(uintptr_t link) { return reinterpret_cast<node *>(link & ~uintptr_t(1)); }
+
+        inline static bool is_marked(uintptr_t link) { return (link & 1) != 0; }
+
+        inline static uintptr_t link_of(node *p) { return reinterpret_cast<uintptr_t>(p); }
+
+        static int random_level() {
+            static thread_local uint64_t seed = 0x9e3779b97f4a7c15ULL ^ reinterpret_cast<uintptr_t>(&seed);
+            seed ^= seed << 13;
+            seed ^= seed >> 7;
+            seed ^= seed << 17;
+            int level = 1;
+            uint64_t bits = seed;
+            while ((bits & 3) == 0 && level < max_level) {//每层以1/4的概率向上延伸
+                ++level;
+                bits >>= 2;
+            }
+            return level;
+        }
+
+        //在各层中找到key的前驱preds与后继succs，途中摘除已标记删除的节点，返回key是否存在
+        bool find_position(const Key &key, link_node **preds, node **succs) const {
+            bool retry = true;
+            while (retry) {
+                retry = false;
+                link_node *pred = head;
+                for (int l = max_level - 1; l >= 0 && !retry; --l) {
+                    node *curr = l < height.load() ? ptr_of(pred->next[l].load()) : nullptr;
+                    while (curr != nullptr) {
+                        uintptr_t succ = curr->next[l].load();
+                        if (is_marked(succ)) {//curr已被逻辑删除，帮助将其从该层摘除
+                            uintptr_t expected = link_of(curr);
+                            if (!pred->next[l].compare_exchange_strong(expected, succ & ~uintptr_t(1))) {
+                                retry = true;//pred已变化，从头重新查找
+                                break;
+                            }
+                            curr = ptr_of(succ);
+                        } else if (Compare()(curr->data.first, key)) {
+                            pred = curr;
+                            curr = ptr_of(succ);
+                        } else { break; }
+                    }
+                    preds[l] = pred;
+                    succs[l] = curr;
+                }
+            }
+            return succs[0] != nullptr && !Compare()(key, succs[0]->data.first);
+        }
+
+        //返回key严格小于key的最大节点；key为nullptr时返回最大节点；不存在时返回nullptr
+        node *find_less(const Key *key) const {
+            link_node *pred = head;
+            for (int l = height.load() - 1; l >= 0; --l) {
+                node *curr = ptr_of(pred->next[l].load());
+                while (curr != nullptr) {
+                    uintptr_t succ = curr->next[l].load();
+                    if (!is_marked(succ) && (key == nullptr || Compare()(curr->data.first, *key))) {
+                        pred = curr;
+                    } else if (!is_marked(succ)) { break; }
+                    curr = ptr_of(succ);
+                }
+            }
+            return pred == head ? nullptr : static_cast<node *>(pred);
+        }
+
+        //返回从p（含）起第一个未被删除的节点
+        inline static node *skip_deleted(node *p) {
+            while (p != nullptr && is_marked(p->next[0].load())) { p = ptr_of(p->next[0].load()); }
+            return p;
+        }
+
+        //插入者或删除者完成时调用，两者都完成后节点已从各层摘除，可以退休
+        void release_owner(node *p) {
+            if (p->owners.fetch_sub(1) == 1) {
+                link_node *preds[max_level];
+                node *succs[max_level];
+                find_position(p->data.first, preds, succs);//摘除插入者在删除后才链接上的层
+                epoch_domain::instance().retire(p);
+            }
+        }
+
+        //删除p，调用者须处于临界区内；p已被他人删除时返回false
+        bool erase_node(node *p) {
+            for (int l = p->level - 1; l >= 1; --l) {//自上而下标记各层
+                uintptr_t succ = p->next[l].load();
+                while (!is_marked(succ)) {
+                    p->next[l].compare_exchange_weak(succ, succ | 1);
+                }
+            }
+            uintptr_t succ = p->next[0].load();
+            while (true) {//最低层的标记成功即为删除生效的时刻
+                if (is_marked(succ)) { return false; }
+                if (p->next[0].compare_exchange_strong(succ, succ | 1)) { break; }
+            }
+            --siz;
+            link_node *preds[max_level];
+            node *succs[max_level];
+            find_position(p->data.first, preds, succs);//物理删除
+            release_owner(p);
+            return true;
+        }
+
+        void raise_height(int level) {
+            int now = height.load();
+            while (now < level && !height.compare_exchange_weak(now, level)) {}
+        }
+
+        void delete_all() {
+            node *p = ptr_of(head->next[0].load());
+            while (p != nullptr) {
+                node *del = p;
+                p = ptr_of(p->next[0].load());
+                delete del;
+            }
+            for (int l = 0; l < max_level; ++l) { head->next[l].store(0); }
+            siz = 0;
+        }
+
+    public:
+
+        class iterator {
+
+            friend class const_iterator;
+
+            friend class skiplist_map;
+
+        private:
+            using difference_type = std::ptrdiff_t;
+            using value_type = skiplist_map::value_type;
+            using pointer = value_type *;
+            using reference = value_type &;
+            using iterator_category = std::bidirectional_iterator_tag;
+
+            epoch_guard guard;//迭代器存在期间当前线程处于临界区
+            skiplist_map *map_point;
+            node *iter_point;
+
+        public:
+
+            iterator() : map_point(nullptr), iter_point(nullptr) {}
+
+            iterator(skiplist_map *map_point_, node *iter_point_) :
+                    map_point(map_point_), iter_point(iter_point_) {}
+
+            iterator(const iterator &other) : map_point(other.map_point), iter_point(other.iter_point) {}
+
+            iterator &operator=(const iterator &other) {
+                map_point = other.map_point;
+                iter_point = other.iter_point;
+                return *this;
+            }
+
+            iterator operator++(int) {
+                iterator tmp(*this);
+                ++(*this);
+                return tmp;
+            }
+
+            iterator &operator++() {
+                if (iter_point == nullptr) { throw invalid_iterator(); }
+                iter_point = skip_deleted(ptr_of(iter_point->next[0].load()));
+                return *this;
+            }
+
+            iterator operator--(int) {
+                iterator tmp(*this);
+                --(*this);
+                return tmp;
+            }
+
+            //单链表无法直接后退，重新查找前驱，O(log n)
+            iterator &operator--() {
+                node *p = map_point->find_less(iter_point == nullptr ? nullptr : &iter_point->data.first);
+                if (p == nullptr) { throw invalid_iterator(); }
+                iter_point = p;
+                return *this;
+            }
+
+            value_type &operator*() const {
+                if (iter_point == nullptr) { throw runtime_error(); }
+                return iter_point->data;
+            }
+
+            bool operator==(const iterator &rhs) const {
+                return map_point == rhs.map_point && iter_point == rhs.iter_point;
+            }
+
+            bool operator==(const const_iterator &rhs) const {
+                return map_point == rhs.map_point && iter_point == rhs.iter_point;
+            }
+
+            bool operator!=(const iterator &rhs) const { return !(*this == rhs); }
+
+            bool operator!=(const const_iterator &rhs) const { return !(*this == rhs); }
+
+            pointer operator->() const noexcept { return &(iter_point->data); }
+
+            skiplist_map *get_map_point() const { return map_point; }
+
+            node *get_iter_point() const { return iter_point; }
+        };
+
+        class const_iterator {
+
+            friend class iterator;
+
+            friend class skiplist_map;
+
+        private:
+            using difference_type = std::ptrdiff_t;
+            using value_type = skiplist_map::value_type;
+            using pointer = const value_type *;
+            using reference = const value_type &;
+            using iterator_category = std::bidirectional_iterator_tag;
+
+            epoch_guard guard;
+            const skiplist_map *map_point;
+            node *iter_point;
+
+        public:
+
+            const_iterator() : map_point(nullptr), iter_point(nullptr) {}
+
+            const_iterator(const skiplist_map *map_point_, node *iter_point_) :
+                    map_point(map_point_), iter_point(iter_point_) {}
+
+            const_iterator(const const_iterator &other) :
+                    map_point(other.map_point), iter_point(other.iter_point) {}
+
+            const_iterator(const iterator &other) :
+                    map_point(other.get_map_point()), iter_point(other.get_iter_point()) {}
+
+            const_iterator &operator=(const const_iterator &other) {
+                map_point = other.map_point;
+                iter_point = other.iter_point;
+                return *this;
+            }
+
+            const_iterator operator++(int) {
+                const_iterator tmp(*this);
+                ++(*this);
+                return tmp;
+            }
+
+            const_iterator &operator++() {
+                if (iter_point == nullptr) { throw invalid_iterator(); }
+                iter_point = skip_deleted(ptr_of(iter_point->next[0].load()));
+                return *this;
+            }
+
+            const_iterator operator--(int) {
+                const_iterator tmp(*this);
+                --(*this);
+                return tmp;
+            }
+
+            const_iterator &operator--() {
+                node *p = map_point->find_less(iter_point == nullptr ? nullptr : &iter_point->data.first);
+                if (p == nullptr) { throw invalid_iterator(); }
+                iter_point = p;
+                return *this;
+            }
+
+            const value_type &operator*() const {
+                if (iter_point == nullptr) { throw runtime_error(); }
+                return iter_point->data;
+            }
+
+            bool operator==(const iterator &rhs) const {
+                return map_point == rhs.get_map_point() && iter_point == rhs.get_iter_point();
+            }
+
+            bool operator==(const const_iterator &rhs) const {
+                return map_point == rhs.map_point && iter_point == rhs.iter_point;
+            }
+
+            bool operator!=(const iterator &rhs) const { return !(*this == rhs); }
+
+            bool operator!=(const const_iterator &rhs) const { return !(*this == rhs); }
+
+            const value_type *operator->() const noexcept { return &(iter_point->data); }
+
+            const skiplist_map *get_map_point() const { return map_point; }
+
+            node *get_iter_point() const { return iter_point; }
+        };
+
+        skiplist_map() : head(new link_node(max_level)), height(1), siz(0) {}
+
+        skiplist_map(const skiplist_map &other) : head(new link_node(max_level)), height(1), siz(0) {
+            for (const_iterator it = other.cbegin(); it != other.cend(); ++it) { insert(*it); }
+        }
+
+        skiplist_map &operator=(const skiplist_map &other) {
+            if (&other == this) { return *this; }
+            delete_all();
+            for (const_iterator it = other.cbegin(); it != other.cend(); ++it) { insert(*it); }
+            return *this;
+        }
+
+        ~skiplist_map() {
+            delete_all();
+            delete head;
+        }
+
+        T &at(const Key &key) {
+            iterator it = find(key);
+            if (it == end()) { throw index_out_of_bound(); }
+            return it->second;
+        }
+
+        const T &at(const Key &key) const {
+            const_iterator it = find(key);
+            if (it == cend()) { throw index_out_of_bound(); }
+            return it->second;
+        }
+
+        T &operator[](const Key &key) { return (insert(value_type(key, T())).first)->second; }
+
+        const T &operator[](const Key &key) const { return at(key); }
+
+        iterator begin() {
+            epoch_guard guard;
+            return iterator(this, skip_deleted(ptr_of(head->next[0].load())));
+        }
+
+        const_iterator cbegin() const {
+            epoch_guard guard;
+            return const_iterator(this, skip_deleted(ptr_of(head->next[0].load())));
+        }
+
+        iterator end() { return iterator(this, nullptr); }
+
+        const_iterator cend() const { return const_iterator(this, nullptr); }
+
+        bool empty() const { return siz.load() == 0; }
+
+        //并发修改时只是近似值
+        size_t size() const { return siz.load(); }
+
+        void clear() { delete_all(); }
+
+        pair<iterator, bool> insert(const value_type &value) {
+            epoch_guard guard;
+            link_node *preds[max_level];
+            node *succs[max_level];
+            int level = random_level();
+            node *p = nullptr;
+            while (true) {//在最低层链接成功即为插入生效的时刻
+                if (find_position(value.first, preds, succs)) {
+                    delete p;//从未发布，可直接释放
+                    return pair<iterator, bool>(iterator(this, succs[0]), false);
+                }
+                if (p == nullptr) { p = new node(level, value); }
+                for (int l = 0; l < level; ++l) { p->next[l].store(link_of(succs[l])); }
+                uintptr_t expected = link_of(succs[0]);
+                if (preds[0]->next[0].compare_exchange_strong(expected, link_of(p))) { break; }
+            }
+            ++siz;
+            raise_height(level);
+            bool linking = true;
+            for (int l = 1; l < level && linking; ++l) {//自下而上链接其余各层
+                while (true) {
+                    uintptr_t succ = p->next[l].load();
+                    if (is_marked(succ)) {//已被删除，不再链接
+                        linking = false;
+                        break;
+                    }
+                    if (ptr_of(succ) != succs[l] &&
+                        !p->next[l].compare_exchange_strong(succ, link_of(succs[l]))) { continue; }
+                    uintptr_t expected = link_of(succs[l]);
+                    if (preds[l]->next[l].compare_exchange_strong(expected, link_of(p))) { break; }
+                    if (!find_position(value.first, preds, succs) || succs[0] != p) {
+                        linking = false;
+                        break;
+                    }
+                }
+            }
+            iterator res(this, p);
+            release_owner(p);
+            return pair<iterator, bool>(res, true);
+        }
+
+        //erase the element at pos.
+        //throw if pos pointed to a bad element (pos == this->end() || pos points an element out of this)
+        void erase(iterator pos) {
+            if (pos.get_map_point() != this || pos.get_iter_point() == nullptr) {
+                throw invalid_iterator();
+            }
+            erase_node(pos.get_iter_point());
+        }
+
+        //删除key对应的元素，返回删除的个数（0或1）
+        size_t erase(const Key &key) {
+            epoch_guard guard;
+            link_node *preds[max_level];
+            node *succs[max_level];
+            while (find_position(key, preds, succs)) {
+                if (erase_node(succs[0])) { return 1; }
+            }
+            return 0;
+        }
+
+        size_t count(const Key &key) const {
+            epoch_guard guard;
+            link_node *preds[max_level];
+            node *succs[max_level];
+            return find_position(key, preds, succs) ? 1 : 0;
+        }
+
+        iterator find(const Key &key) {
+            epoch_guard guard;
+            link_node *preds[max_level];
+            node *succs[max_level];
+            if (find_position(key, preds, succs)) { return iterator(this, succs[0]); }
+            return iterator(this, nullptr);
+        }
+
+        const_iterator find(const Key &key) const {
+            epoch_guard guard;
+            link_node *preds[max_level];
+            node *succs[max_level];
+            if (find_position(key, preds, succs)) { return const_iterator(this, succs[0]); }
+            return const_iterator(this, nullptr);
+        }
+    };
+}
+
+#endif
@@ -0,0 +1,141 @@
+/**
+ * compares concurrent_priority_queue with a sjtu::priority_queue behind one std::mutex
+ * g++ -std=c++17 -O2 -pthread -I.. concurrent_priority_queue_bench.cpp && ./a.out [threads] [ops per thread]
+ * throughput: runs with 1, 2, 4, ... up to threads (default: hardware threads) and prints Mops/s
+ * rank error: pops one element after every push on one thread, and measures how many of the
+ * elements left in the queue are larger than the popped one
+ */
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "priority_queue.hpp"
+#include "concurrent_priority_queue.hpp"
+
+static const int prefill = 100000;
+
+struct rng {
+    unsigned long long state;
+
+    explicit rng(unsigned long long seed) : state(seed * 2654435761u + 1) {}
+
+    unsigned next() {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return unsigned(state);
+    }
+};
+
+//单个互斥锁保护的sjtu::priority_queue，作为对照
+struct locked_queue {
+    std::mutex lock;
+    sjtu::priority_queue<int, std::less<int>, sjtu::dary_storage<> > heap;
+
+    void push(int e) {
+        std::lock_guard<std::mutex> guard(lock);
+        heap.push(e);
+    }
+
+    bool try_pop(int &result) {
+        std::lock_guard<std::mutex> guard(lock);
+        if (heap.empty()) { return false; }
+        heap.pop(result);
+        return true;
+    }
+};
+
+struct relaxed_queue {
+    sjtu::concurrent_priority_queue<int> heap;
+
+    void push(int e) { heap.push(e); }
+
+    bool try_pop(int &result) { return heap.try_pop(result); }
+};
+
+//在threads个线程上各交替执行ops次push与try_pop，返回每秒百万次操作数
+template<class Queue>
+double run(int threads, int ops) {
+    Queue q;
+    rng fill(0);
+    for (int i = 0; i < prefill; ++i) { q.push(int(fill.next() >> 1)); }
+    std::atomic<int> ready(0);
+    std::atomic<bool> go(false);
+    std::atomic<long long> sum(0);//防止弹出被优化掉
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.push_back(std::thread([&q, &ready, &go, &sum, t, ops]() {
+            rng r(t + 1);
+            long long local = 0;
+            ++ready;
+            while (!go.load()) { std::this_thread::yield(); }
+            for (int i = 0; i < ops; i += 2) {
+                q.push(int(r.next() >> 1));
+                int top;
+                if (q.try_pop(top)) { local += top; }
+            }
+            sum += local;
+        }));
+    }
+    while (ready.load() < threads) { std::this_thread::yield(); }
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    go = true;
+    for (int t = 0; t < threads; ++t) { workers[t].join(); }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return double(threads) * ops / elapsed.count() / 1e6;
+}
+
+//用树状数组统计队列中大于弹出元素的个数；元素取[0, n)的一个排列，互不相同
+static void rank_error(size_t heap_count, int steps) {
+    int n = prefill + steps;
+    std::vector<int> order(n), tree(n + 1, 0);
+    for (int i = 0; i < n; ++i) { order[i] = i; }
+    rng r(42);
+    for (int i = n - 1; i > 0; --i) { std::swap(order[i], order[r.next() % unsigned(i + 1)]); }
+    sjtu::concurrent_priority_queue<int> q(heap_count);
+    int present = 0;
+    auto add = [&tree, n](int e, int delta) { for (++e; e <= n; e += e & -e) { tree[e] += delta; } };
+    auto not_greater = [&tree](int e) { int s = 0; for (++e; e > 0; e -= e & -e) { s += tree[e]; } return s; };
+    for (int i = 0; i < prefill; ++i) {
+        q.push(order[i]);
+        add(order[i], 1);
+        ++present;
+    }
+    double total = 0;
+    int worst = 0;
+    for (int i = prefill; i < n; ++i) {
+        q.push(order[i]);
+        add(order[i], 1);
+        int top;
+        q.try_pop(top);
+        int rank = present + 1 - not_greater(top);//队列中比top大的元素个数
+        add(top, -1);
+        total += rank;
+        if (rank > worst) { worst = rank; }
+    }
+    std::printf("%8zu %12.1f %12d\n", heap_count, total / steps, worst);
+}
+
+int main(int argc, char *argv[]) {
+    int max_threads = argc > 1 ? std::atoi(argv[1]) : int(std::thread::hardware_concurrency());
+    int ops = argc > 2 ? std::atoi(argv[2]) : 1000000;
+    if (max_threads < 1) { max_threads = 1; }
+    if (ops < 2) { ops = 2; }
+    std::printf("push/pop pairs on %d prefilled elements, %d ops per thread, Mops/s\n", prefill, ops);
+    std::printf("%8s %12s %27s\n", "threads", "locked heap", "concurrent_priority_queue");
+    for (int threads = 1;; threads *= 2) {
+        if (threads > max_threads) { threads = max_threads; }
+        double locked = run<locked_queue>(threads, ops);
+        double relaxed = run<relaxed_queue>(threads, ops);
+        std::printf("%8d %12.2f %27.2f\n", threads, locked, relaxed);
+        if (threads == max_threads) { break; }
+    }
+    std::printf("\nrank error of one pop after every push, %d pops\n", ops / 2);
+    std::printf("%8s %12s %12s\n", "heaps", "mean", "max");
+    size_t heap_counts[] = {8, 16, 64};
+    for (size_t heap_count : heap_counts) { rank_error(heap_count, ops / 2); }
+    return 0;
+}
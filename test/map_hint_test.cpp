@@ -0,0 +1,57 @@
+/**
+ * checks hinted insertion into map, multimap, set and multiset
+ * g++ -std=c++17 -I.. map_hint_test.cpp && ./a.out
+ */
+#include <cstdio>
+#include "map.hpp"
+#include "set.hpp"
+
+static int failures = 0;
+
+#define CHECK(cond) do { if (!(cond)) { std::printf("%s:%d: %s\n", __FILE__, __LINE__, #cond); ++failures; } } while (0)
+
+int main() {
+    {//hint指向相同的key
+        sjtu::multiset<int> s;
+        s.insert(5);
+        sjtu::multiset<int>::iterator it = s.find(5);
+        s.insert(it, 5);
+        CHECK(s.count(5) == 2);
+        CHECK(s.size() == 2);
+    }
+    {
+        sjtu::multimap<int, int> m;
+        m.insert(sjtu::pair<const int, int>(1, 1));
+        sjtu::multimap<int, int>::iterator it = m.find(1);
+        m.insert(it, sjtu::pair<const int, int>(1, 2));
+        m.emplace_hint(m.find(1), 1, 3);
+        CHECK(m.count(1) == 3);
+        int expect = 1;//相同的key保持插入顺序
+        for (sjtu::multimap<int, int>::iterator i = m.begin(); i != m.end(); ++i) { CHECK(i->second == expect++); }
+    }
+    {//hint为end()、前驱与value相同、hint不准确
+        sjtu::multiset<int> s;
+        for (int i = 0; i < 100; ++i) { s.insert(s.end(), i / 10); }
+        for (int i = 0; i < 100; ++i) { s.insert(s.upper_bound(i % 10), i % 10); }
+        for (int i = 0; i < 100; ++i) { s.insert(s.begin(), i % 10); }
+        CHECK(s.size() == 300);
+        for (int k = 0; k < 10; ++k) { CHECK(s.count(k) == 30); }
+        int last = -1;
+        for (sjtu::multiset<int>::iterator i = s.begin(); i != s.end(); ++i) {
+            CHECK(last <= *i);
+            last = *i;
+        }
+    }
+    {//不允许重复时，hint的key相同则不插入
+        sjtu::set<int> s;
+        s.insert(5);
+        sjtu::set<int>::iterator it = s.insert(s.find(5), 5);
+        CHECK(it == s.find(5));
+        CHECK(s.size() == 1);
+        s.insert(s.end(), 7);
+        s.insert(s.find(7), 6);
+        CHECK(s.size() == 3);
+    }
+    if (failures == 0) { std::printf("map_hint_test: ok\n"); }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,122 @@
+/**
+ * compares the throughput of skiplist_map with a sjtu::map behind one std::mutex
+ * g++ -std=c++17 -O2 -pthread -I.. skiplist_map_bench.cpp && ./a.out [threads] [ops per thread] [find percent]
+ * runs with 1, 2, 4, ... up to threads (default: hardware threads) and prints Mops/s;
+ * a low find percent (e.g. 0) gives the write-heavy case
+ */
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "map.hpp"
+#include "skiplist_map.hpp"
+
+static const int key_range = 1 << 16;
+static int find_percent = 80;//其余的操作一半插入、一半删除，可由命令行指定
+
+struct rng {
+    unsigned long long state;
+
+    explicit rng(unsigned long long seed) : state(seed * 2654435761u + 1) {}
+
+    unsigned next() {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return unsigned(state);
+    }
+};
+
+//单个互斥锁保护的sjtu::map，作为对照
+struct locked_map {
+    std::mutex lock;
+    sjtu::map<int, int> data;
+
+    bool insert(int key, int value) {
+        std::lock_guard<std::mutex> guard(lock);
+        return data.insert(sjtu::map<int, int>::value_type(key, value)).second;
+    }
+
+    size_t erase(int key) {
+        std::lock_guard<std::mutex> guard(lock);
+        return data.erase(key);
+    }
+
+    bool find(int key, int &result) {
+        std::lock_guard<std::mutex> guard(lock);
+        sjtu::map<int, int>::iterator it = data.find(key);
+        if (it == data.end()) { return false; }
+        result = it->second;
+        return true;
+    }
+};
+
+struct lock_free_map {
+    sjtu::skiplist_map<int, int> data;
+
+    bool insert(int key, int value) { return data.insert(sjtu::skiplist_map<int, int>::value_type(key, value)).second; }
+
+    size_t erase(int key) { return data.erase(key); }
+
+    bool find(int key, int &result) {
+        sjtu::skiplist_map<int, int>::iterator it = data.find(key);
+        if (it == data.end()) { return false; }
+        result = it->second;
+        return true;
+    }
+};
+
+//在threads个线程上各执行ops次混合操作，返回每秒百万次操作数
+template<class Map>
+double run(int threads, int ops) {
+    Map m;
+    for (int i = 0; i < key_range; i += 2) { m.insert(i, i); }
+    std::atomic<int> ready(0);
+    std::atomic<bool> go(false);
+    std::atomic<long long> found(0);//防止查找被优化掉
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.push_back(std::thread([&m, &ready, &go, &found, t, ops]() {
+            rng r(t + 1);
+            long long hits = 0;
+            ++ready;
+            while (!go.load()) { std::this_thread::yield(); }
+            for (int i = 0; i < ops; ++i) {
+                int key = int(r.next() % key_range);
+                unsigned kind = r.next() % 100;
+                int value;
+                if (kind < unsigned(find_percent)) { hits += m.find(key, value); }
+                else if (kind % 2 == 0) { m.insert(key, i); }
+                else { m.erase(key); }
+            }
+            found += hits;
+        }));
+    }
+    while (ready.load() < threads) { std::this_thread::yield(); }
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    go = true;
+    for (int t = 0; t < threads; ++t) { workers[t].join(); }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return double(threads) * ops / elapsed.count() / 1e6;
+}
+
+int main(int argc, char *argv[]) {
+    int max_threads = argc > 1 ? std::atoi(argv[1]) : int(std::thread::hardware_concurrency());
+    int ops = argc > 2 ? std::atoi(argv[2]) : 1000000;
+    if (argc > 3) { find_percent = std::atoi(argv[3]); }
+    if (max_threads < 1) { max_threads = 1; }
+    if (ops < 1) { ops = 1; }
+    std::printf("%d%% find, keys in [0, %d), %d ops per thread, Mops/s\n", find_percent, key_range, ops);
+    std::printf("%8s %12s %13s\n", "threads", "locked map", "skiplist_map");
+    for (int threads = 1;; threads *= 2) {
+        if (threads > max_threads) { threads = max_threads; }
+        double locked = run<locked_map>(threads, ops);
+        double lock_free = run<lock_free_map>(threads, ops);
+        std::printf("%8d %12.2f %13.2f\n", threads, locked, lock_free);
+        if (threads == max_threads) { break; }
+    }
+    return 0;
+}
@@ -0,0 +1,87 @@
+/**
+ * stresses skiplist_map from several threads at once
+ * g++ -std=c++17 -pthread -I.. skiplist_map_stress.cpp && ./a.out
+ * (add -fsanitize=thread to look for data races)
+ */
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include <vector>
+#include "skiplist_map.hpp"
+
+static std::atomic<int> failures(0);
+
+#define CHECK(cond) do { if (!(cond)) { std::printf("%s:%d: %s\n", __FILE__, __LINE__, #cond); ++failures; } } while (0)
+
+typedef sjtu::skiplist_map<int, int> map_type;
+
+static const int thread_count = 8;
+static const int own_keys = 20000;//每个线程独占的key
+static const int shared_keys = 64;//所有线程争抢的key
+static const int rounds = 200000;
+
+struct rng {
+    unsigned long long state;
+
+    explicit rng(unsigned long long seed) : state(seed * 2654435761u + 1) {}
+
+    unsigned next() {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return unsigned(state);
+    }
+};
+
+int main() {
+    map_type m;
+    std::atomic<int> balance[shared_keys];//各共享key成功插入与删除次数之差，结束时应与count一致
+    for (int i = 0; i < shared_keys; ++i) { balance[i] = 0; }
+    std::atomic<bool> writers_done(false);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < thread_count; ++t) {
+        threads.push_back(std::thread([&m, &balance, t]() {
+            rng r(t + 1);
+            int base = shared_keys + t * own_keys;
+            for (int i = 0; i < own_keys; ++i) {
+                CHECK(m.insert(map_type::value_type(base + i, t)).second);
+            }
+            for (int i = 0; i < own_keys; i += 2) { CHECK(m.erase(base + i) == 1); }
+            for (int i = 0; i < rounds; ++i) {
+                int key = int(r.next() % shared_keys);
+                if (r.next() % 2 == 0) {
+                    if (m.insert(map_type::value_type(key, t)).second) { ++balance[key]; }
+                } else if (m.erase(key) == 1) { --balance[key]; }
+            }
+            for (int i = 0; i < own_keys; ++i) {
+                map_type::iterator it = m.find(base + i);
+                if (i % 2 == 0) { CHECK(it == m.end()); }
+                else { CHECK(it != m.end() && it->second == t); }
+            }
+        }));
+    }
+    std::thread reader([&m, &writers_done]() {//写者运行期间反复遍历，key须严格递增
+        while (!writers_done.load()) {
+            int last = -1;
+            for (map_type::iterator it = m.begin(); it != m.end(); ++it) {
+                CHECK(it->first > last);
+                last = it->first;
+            }
+        }
+    });
+    for (int t = 0; t < thread_count; ++t) { threads[t].join(); }
+    writers_done = true;
+    reader.join();
+    size_t expect = size_t(thread_count) * (own_keys / 2);
+    for (int i = 0; i < shared_keys; ++i) {
+        CHECK(balance[i] == 0 || balance[i] == 1);
+        CHECK(m.count(i) == size_t(balance[i].load()));
+        expect += size_t(balance[i].load());
+    }
+    CHECK(m.size() == expect);
+    size_t walked = 0;
+    for (map_type::iterator it = m.begin(); it != m.end(); ++it) { ++walked; }
+    CHECK(walked == expect);
+    if (failures == 0) { std::printf("skiplist_map_stress: ok\n"); }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,252 @@
+/**
+ * implement a hierarchical timing wheel
+ */
+#ifndef SJTU_TIMING_WHEEL_HPP
+#define SJTU_TIMING_WHEEL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include "exceptions.hpp"
+#include "node_pool.hpp"
+
+namespace sjtu {
+
+    /**
+     * a set of timers, each carrying a T, driven by a clock counted in ticks.
+     * the wheel has level_count levels of slot_count slots; a level-L slot covers
+     * slot_count^L ticks. a timer is put in the lowest level whose current window contains its
+     * expiry, and when the clock enters a new window of a level, the matching slot of the level
+     * above is emptied and its timers are put again one level lower (cascading). schedule and
+     * cancel take O(1): every slot is an intrusive doubly linked list, and nodes come from a
+     * node_pool. timers expiring beyond the top level stay there and are put back until their
+     * window is reached.
+     * schedule returns a handle carrying the node and a generation number unique to the timer;
+     * a handle whose timer has fired or been cancelled is detected as stale, even if its node
+     * has been reused.
+     */
+    template<class T>
+    class timing_wheel {
+    public:
+
+        static const int slot_bits = 8;
+        static const int slot_count = 1 << slot_bits;
+        static const int level_count = 4;
+
+    private:
+
+        struct link {
+            link *next;
+            link *prev;
+
+            link() : next(this), prev(this) {}//空的环形链表，作为哨兵
+        };
+
+        struct node : link {
+            uint64_t generation;//不在节点开头，回收到node_pool后仍保留，为0表示已失效
+            uint64_t expires;
+            alignas(T) unsigned char storage[sizeof(T)];
+
+            T &value() { return *reinterpret_cast<T *>(storage); }
+        };
+
+        link slots[level_count][slot_count];
+        link expired;//已到期、尚未调用回调的节点
+        uint64_t clock;
+        uint64_t next_generation;
+        size_t siz;
+        node_pool<node> pool;
+
+        inline static void unlink(link *p) {
+            p->prev->next = p->next;
+            p->next->prev = p->prev;
+        }
+
+        inline static void link_before(link *pos, link *p) {
+            p->prev = pos->prev;
+            p->next = pos;
+            pos->prev->next = p;
+            pos->prev = p;
+        }
+
+        //把from中的节点全部移到to的末尾，from变为空
+        inline static void splice(link *to, link *from) {
+            if (from->next == from) { return; }
+            from->next->prev = to->prev;
+            to->prev->next = from->next;
+            from->prev->next = to;
+            to->prev = from->prev;
+            from->next = from->prev = from;
+        }
+
+        //按当前时间把p放入槽中：key与clock在更高位上都相同的最低一层，超出最高层时放在最高层
+        void place(node *p) {
+            int level = 0;
+            while (level < level_count - 1 &&
+                   (p->expires >> ((level + 1) * slot_bits)) != (clock >> ((level + 1) * slot_bits))) {
+                ++level;
+            }
+            link_before(&slots[level][(p->expires >> (level * slot_bits)) & (slot_count - 1)], p);
+        }
+
+        void destroy_node(node *p) {
+            p->value().~T();
+            p->generation = 0;
+            pool.deallocate(p);
+        }
+
+        void delete_list(link *head) {
+            for (link *p = head->next; p != head;) {
+                link *q = p->next;
+                destroy_node(static_cast<node *>(p));
+                p = q;
+            }
+            head->next = head->prev = head;
+        }
+
+        //时钟进入新的一格后，把各层与之对应的槽中的节点放入更低的层，自上而下进行
+        void cascade() {
+            for (int level = level_count - 1; level > 0; --level) {
+                if ((clock & ((uint64_t(1) << (level * slot_bits)) - 1)) != 0) { continue; }
+                link batch;
+                splice(&batch, &slots[level][(clock >> (level * slot_bits)) & (slot_count - 1)]);
+                for (link *p = batch.next; p != &batch;) {
+                    link *q = p->next;
+                    place(static_cast<node *>(p));
+                    p = q;
+                }
+            }
+        }
+
+        //依次对expired中的节点调用fire，返回调用的次数。fire抛出异常时该节点仍被删除，
+        //其余节点留在expired中，下次advance时先处理
+        template<class Callback>
+        size_t fire_expired(Callback &fire) {
+            size_t count = 0;
+            while (expired.next != &expired) {
+                node *p = static_cast<node *>(expired.next);
+                unlink(p);
+                p->generation = 0;//回调中取消自身时视为已失效
+                --siz;
+                ++count;
+                try {
+                    fire(p->value());
+                } catch (...) {
+                    destroy_node(p);
+                    throw;
+                }
+                destroy_node(p);
+            }
+            return count;
+        }
+
+    public:
+
+        /**
+         * identifies a scheduled timer.
+         * it stays comparable and testable after the timer fires or is cancelled; cancel and
+         * active then simply report that the timer no longer exists.
+         */
+        class handle {
+            friend class timing_wheel;
+
+        private:
+            node *point;
+            uint64_t generation;
+
+            handle(node *point_, uint64_t generation_) : point(point_), generation(generation_) {}
+
+        public:
+            handle() : point(nullptr), generation(0) {}
+
+            bool operator==(const handle &rhs) const { return point == rhs.point && generation == rhs.generation; }
+
+            bool operator!=(const handle &rhs) const { return !(*this == rhs); }
+        };
+
+        explicit timing_wheel(uint64_t start = 0) : clock(start), next_generation(1), siz(0) {}
+
+        timing_wheel(const timing_wheel &other) = delete;
+
+        timing_wheel &operator=(const timing_wheel &other) = delete;
+
+        ~timing_wheel() { clear(); }
+
+        //当前时间
+        uint64_t now() const { return clock; }
+
+        //delay个tick后到期，delay为0时在下一个tick到期
+        handle schedule(uint64_t delay, const T &value) {
+            node *p = new(pool.allocate()) node;
+            try {
+                new(p->storage) T(value);
+            } catch (...) {
+                pool.deallocate(p);
+                throw;
+            }
+            p->generation = next_generation++;
+            p->expires = clock + (delay == 0 ? 1 : delay);
+            place(p);
+            ++siz;
+            return handle(p, p->generation);
+        }
+
+        //取消h对应的计时器，返回其是否仍存在
+        bool cancel(handle h) {
+            if (!active(h)) { return false; }
+            unlink(h.point);
+            destroy_node(h.point);
+            --siz;
+            return true;
+        }
+
+        //h对应的计时器是否尚未到期或取消
+        bool active(handle h) const { return h.point != nullptr && h.point->generation == h.generation; }
+
+        /**
+         * moves the clock forward by ticks, calling fire(T &) on every timer as it expires, in
+         * order of expiry; the timer is removed after the call. fire may schedule or cancel
+         * timers. returns the number of timers fired.
+         * if fire throws, the clock stops at the tick being processed, and the remaining timers of
+         * that tick are fired first by the next call (which may pass 0 ticks).
+         */
+        template<class Callback>
+        size_t advance(uint64_t ticks, Callback fire) {
+            size_t count = fire_expired(fire);
+            for (; ticks > 0; --ticks) {
+                if (siz == 0) {//没有计时器时直接跳过
+                    clock += ticks;
+                    break;
+                }
+                ++clock;
+                cascade();
+                splice(&expired, &slots[0][clock & (slot_count - 1)]);
+                count += fire_expired(fire);
+            }
+            return count;
+        }
+
+        template<class Callback>
+        size_t tick(Callback fire) { return advance(1, fire); }
+
+        size_t size() const { return siz; }
+
+        bool empty() const { return siz == 0; }
+
+        //将pool中缓存的空闲节点还给系统。此后已到期或已取消的计时器的handle不可再传给cancel与active，
+        //它们会读取已释放节点上的代号
+        void shrink_to_fit() { pool.release(); }
+
+        //删除所有计时器，不调用回调
+        void clear() {
+            for (int level = 0; level < level_count; ++level) {
+                for (int i = 0; i < slot_count; ++i) { delete_list(&slots[level][i]); }
+            }
+            delete_list(&expired);
+            siz = 0;
+        }
+    };
+}
+
+#endif